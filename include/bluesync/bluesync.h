@@ -56,6 +56,18 @@ typedef enum {
  */
 void bluesync_init(void);
 
+#if defined(CONFIG_BLUESYNC_EXEC_WORKQUEUE)
+/**
+ * @brief Selects the work queue BlueSync runs on.
+ *
+ * Must be called before bluesync_init(). Without it, the system work
+ * queue is used.
+ *
+ * @param work_q Work queue, already started.
+ */
+void bluesync_set_work_queue(struct k_work_q *work_q);
+#endif
+
 /**
  * @brief Sets the operational role of the BlueSync node.
  *
@@ -70,6 +82,90 @@ void bluesync_init(void);
  */
 void bluesync_set_role(bluesync_role_t role);
 
+/**
+ * @brief Counters of the advertisements seen by the BlueSync scanner,
+ * since boot.
+ */
+struct bluesync_rx_stats {
+	uint32_t accepted;             /**< BlueSync messages queued for processing. */
+	uint32_t overruns;             /**< BlueSync messages dropped, the thread lagged behind. */
+	uint32_t malformed;            /**< Advertising data with an invalid AD structure. */
+	uint32_t no_manufacturer_data; /**< Advertisements without manufacturer data. */
+	uint32_t foreign_company_id;   /**< Manufacturer data of another company ID. */
+	uint32_t bad_length;           /**< BlueSync manufacturer data of unexpected length or version. */
+	uint32_t duplicates;           /**< BlueSync messages of a slot already received from the same source. */
+	uint32_t untracked;            /**< BlueSync messages of a round from more sources than tracked. */
+};
+
+/**
+ * @brief Gets the receive counters of the BlueSync scanner.
+ *
+ * Advertisements which are not BlueSync messages are only counted, so
+ * that foreign traffic costs as little as possible.
+ *
+ * @param stats Filled with the current counters.
+ */
+void bluesync_get_rx_stats(struct bluesync_rx_stats *stats);
+
+#if defined(CONFIG_BLUESYNC_SCHEDULED_SCAN)
+/**
+ * @brief Radio time of a client while waiting for a round, since boot.
+ *
+ * The radio-on time saved by the scheduled scanning is
+ * wait_ms - scan_ms.
+ */
+struct bluesync_scan_stats {
+	uint32_t wait_ms;        /**< Time spent waiting for a round. */
+	uint32_t scan_ms;        /**< Scanning time while waiting for a round. */
+	uint32_t missed_windows; /**< Predicted windows closed without the round. */
+};
+
+/**
+ * @brief Gets the scanning time counters of a client.
+ *
+ * @param stats Filled with the current counters.
+ */
+void bluesync_get_scan_stats(struct bluesync_scan_stats *stats);
+#endif
+
+/**
+ * @brief Synchronization quality of a node, in increasing order.
+ */
+typedef enum {
+	BLUESYNC_LOCK_NONE = 0,   /**< Never synchronized, the time is uncorrected. */
+	BLUESYNC_LOCK_OFFSET = 1, /**< Offset only, from the first packets of a round. */
+	BLUESYNC_LOCK_SKEW = 2,   /**< Offset and skew, still refined as pairs and rounds arrive. */
+	BLUESYNC_LOCK_FULL = 3    /**< Estimated over CONFIG_BLUESYNC_LOCK_BURSTS bursts. */
+} bluesync_lock_state_t;
+
+/**
+ * @brief Called when the lock state of the node rises.
+ *
+ * Runs in the BlueSync execution context, it must not block.
+ *
+ * @param state New lock state.
+ */
+typedef void (*bluesync_lock_cb_t)(bluesync_lock_state_t state);
+
+/**
+ * @brief Registers the lock state callback.
+ *
+ * Should be called before bluesync_set_role(). The authority is
+ * reported as BLUESYNC_LOCK_FULL once its role is set. Without
+ * CONFIG_BLUESYNC_FAST_ACQUISITION, a client goes from
+ * BLUESYNC_LOCK_NONE to BLUESYNC_LOCK_SKEW at its first update.
+ *
+ * @param cb Callback, NULL to unregister.
+ */
+void bluesync_set_lock_cb(bluesync_lock_cb_t cb);
+
+/**
+ * @brief Gets the lock state of the node.
+ *
+ * @return Current lock state.
+ */
+bluesync_lock_state_t bluesync_get_lock_state(void);
+
 /**
  * @brief Starts a BlueSync synchronization round as the time authority.
  *
@@ -94,10 +190,90 @@ void bluesync_start_net_sync_with_unix_epoch_us(uint64_t unix_epoch_us);
  * This returns the current time as synchronized with the authority node,
  * expressed in microseconds since the UNIX epoch.
  *
+ * This method is lock-free and can be called from an ISR.
+ *
  * @return Current synchronized UNIX timestamp in microseconds.
  */
 uint64_t get_current_unix_time_us(void);
 
+/**
+ * @brief Reads the local time source selected with CONFIG_BLUESYNC_TIME_SOURCE.
+ *
+ * Timestamps passed to the conversion functions below must be taken with
+ * this function. With the default source it returns k_uptime_ticks().
+ * ISR-safe.
+ *
+ * @return Current value of the time source, in its ticks.
+ */
+int64_t get_local_timestamp_ticks(void);
+
+/**
+ * @brief Converts an uptime ticks value into a synchronized UNIX time.
+ *
+ * ISR-safe variant intended for timestamps captured with
+ * get_local_timestamp_ticks() in an interrupt handler. The current clock correction is applied to the
+ * given value.
+ *
+ * @param uptime_ticks Value returned by get_local_timestamp_ticks().
+ *
+ * @return Synchronized UNIX timestamp in microseconds.
+ */
+uint64_t get_unix_time_us_at_uptime(int64_t uptime_ticks);
+
+/**
+ * @brief Converts a buffer of uptime ticks values into synchronized UNIX times.
+ *
+ * The current correction is read once for the whole buffer, which is then
+ * converted in a single integer-only loop. Intended for sample buffers
+ * timestamped with get_local_timestamp_ticks().
+ *
+ * With CONFIG_BLUESYNC_FIXED_POINT_CORRECTION, the results are those of
+ * get_unix_time_us_at_uptime(). Otherwise they may differ from it by up to
+ * one tick plus 1 us (32 us at 32768 Hz): the per-element path rounds and
+ * truncates in double.
+ *
+ * @param uptime_ticks Values returned by get_local_timestamp_ticks().
+ * @param unix_time_us Synchronized UNIX timestamps in microseconds. May
+ *                     point to the same buffer as @p uptime_ticks to
+ *                     convert in place.
+ * @param count        Number of values to convert.
+ */
+void convert_uptime_ticks_to_unix_time_us_batch(const int64_t *uptime_ticks, uint64_t *unix_time_us,
+						size_t count);
+
+#if defined(CONFIG_BLUESYNC_TIME_MAP)
+/**
+ * @brief Converts a past uptime ticks value into a synchronized UNIX time.
+ *
+ * Unlike get_unix_time_us_at_uptime(), the correction that was in force
+ * when the timestamp was taken is used, even if a synchronization happened
+ * since then. ISR-safe.
+ *
+ * @param uptime_ticks Value returned by get_local_timestamp_ticks() when the timestamp was taken.
+ * @param unix_time_us Synchronized UNIX timestamp in microseconds.
+ *
+ * @return true if the correction of that time was still available, false
+ *         if the timestamp is older than the kept corrections (the oldest
+ *         one is then used).
+ */
+bool get_unix_time_us_at_past_uptime(int64_t uptime_ticks, uint64_t *unix_time_us);
+#endif
+
+#if defined(CONFIG_BLUESYNC_ESTIMATOR_KALMAN)
+/**
+ * @brief Covariance of the Kalman servo estimate.
+ *
+ * Index 0 is the offset, in ticks, and index 1 the skew (slope - 1), as
+ * estimated at the last committed burst.
+ *
+ * @param cov Filled with the covariance matrix.
+ *
+ * @return false if no burst was folded in since the start or the last
+ *         reset of the filter.
+ */
+bool bluesync_get_servo_covariance(double cov[2][2]);
+#endif
+
 #endif /* BLUESYNC_H */
 
 /** @} */ // end of bluesync_api
@@ -26,6 +26,7 @@
 #include <zephyr/bluetooth/mesh.h>
 #include <zephyr/sys/byteorder.h>
 #include <zephyr/sys/util.h>
+#include <zephyr/random/random.h>
 
 #include <math.h>
 
@@ -38,8 +39,17 @@
 #include <bluesync/bluesync.h>
 #include "bluesync.h"
 #include "bs_state_machine.h"
+#include "bluesync_time_source.h"
+#include "bluesync_rx_ring.h"
 #include "bluesync_bitfields.h"
+#include "bluesync_msg.h"
+#include "bluesync_history.h"
+#include "bluesync_regression.h"
+#if defined(CONFIG_BLUESYNC_CALIBRATION_STORE)
+#include "bluesync_calib.h"
+#endif
 #include "local_time.h"
+#include "estimator/bluesync_estimator.h"
 
 
 #if defined(CONFIG_BLUESYNC_TEST_BABBLESIM_SUPPORT)
@@ -64,30 +74,16 @@ static struct bluesync_param param = {
 		.bitfield = {0},
 	},
 	.local_mutex = Z_MUTEX_INITIALIZER(param.local_mutex),
-	.local_history = {
-		[0 ... BURST_WINDOWS_SIZE-1] = {
-			.timer_ticks = {0},
-			.bitfield = {0},
-		}
-	},
-	.local_head = 0,
-    .local_count = 0,
-	.local_history_mutex = Z_MUTEX_INITIALIZER(param.local_history_mutex),
 
 	.rcv = {
 		.timer_ticks = {0},
 		.bitfield = {0},
 	},
 	.rcv_mutex = Z_MUTEX_INITIALIZER(param.rcv_mutex),
-	.rcv_history = {
-		[0 ... BURST_WINDOWS_SIZE-1] = {
-			.timer_ticks = {0},
-			.bitfield = {0},
-		}
-	},
-	.rcv_head = 0,
-    .rcv_count = 0,
-	.rcv_history_mutex = Z_MUTEX_INITIALIZER(param.rcv_history_mutex),
+
+	.history_head = 0,
+	.history_count = 0,
+	.history_mutex = Z_MUTEX_INITIALIZER(param.history_mutex),
 
 	.current_round_id = 0xFF,
 	.adv_param = BT_LE_ADV_PARAM_INIT(
@@ -108,13 +104,77 @@ static struct bluesync_param param = {
 	.mutex = Z_MUTEX_INITIALIZER(param.mutex),
 };
 
+#if defined(CONFIG_BLUESYNC_EXEC_THREAD)
 // Define the stack space for the thread
 K_THREAD_STACK_DEFINE(bluesync_thread_stack, CONFIG_BLUESYNC_THREAD_STACK_SIZE);
+#endif
 
-K_MSGQ_DEFINE(bluesync_rx_msgq, sizeof(struct bluesync_msg_client), 17, 1);
-K_SEM_DEFINE(bluesync_end_sync_sem, 0, 1);
-K_SEM_DEFINE(bluesync_start_new_sync_sem, 0, 1);
+static struct bluesync_rx_ring bluesync_rx_ring = BLUESYNC_RX_RING_INITIALIZER;
+static atomic_t rx_duplicates = ATOMIC_INIT(0);
+static atomic_t rx_untracked = ATOMIC_INIT(0);
+
+static atomic_t lock_state = ATOMIC_INIT(BLUESYNC_LOCK_NONE);
+static bluesync_lock_cb_t lock_cb;
+
+#define BLUESYNC_LOCK_BURSTS MIN(CONFIG_BLUESYNC_LOCK_BURSTS, BURST_WINDOWS_SIZE)
+
+#if defined(CONFIG_BLUESYNC_SCHEDULED_SCAN)
+static atomic_t scan_wait_ms = ATOMIC_INIT(0);
+static atomic_t scan_on_ms = ATOMIC_INIT(0);
+static atomic_t scan_missed_windows = ATOMIC_INIT(0);
+
+static void bluesync_scan_round_start(const struct bluesync_msg_client *msg);
+#endif
+
+/*
+ * Everything runs in a single execution context, either the bluesync
+ * thread or a work queue. Timers, callbacks and the public API only post
+ * events to it.
+ */
+enum bluesync_event {
+	BLUESYNC_EVT_INIT,
+	BLUESYNC_EVT_NEW_NET_SYNC,
+	BLUESYNC_EVT_RX,
+	BLUESYNC_EVT_SYNC_EXPIRED,
+	BLUESYNC_EVT_ADV_SLOT,
+	BLUESYNC_EVT_ADV_PRELOAD,
+	BLUESYNC_EVT_RELAY_BACKOFF,
+	BLUESYNC_EVT_SCAN_WINDOW,
+	BLUESYNC_EVT_AUTO_ROUND,
+	BLUESYNC_EVT_AUTO_LISTEN_END,
+	BLUESYNC_EVT_NUM,
+};
+
+static void bluesync_post(enum bluesync_event event);
+
+#if defined(CONFIG_BLUESYNC_EXEC_THREAD)
 K_SEM_DEFINE(bluesync_role_assign_sem, 0, 1);
+K_SEM_DEFINE(bluesync_start_new_sync_sem, 0, 1);
+K_SEM_DEFINE(bluesync_rx_sem, 0, 1);
+K_SEM_DEFINE(bluesync_end_sync_sem, 0, 1);
+K_SEM_DEFINE(bluesync_adv_slot_sem, 0, 1);
+K_SEM_DEFINE(bluesync_adv_preload_sem, 0, 1);
+K_SEM_DEFINE(bluesync_relay_backoff_sem, 0, 1);
+K_SEM_DEFINE(bluesync_scan_window_sem, 0, 1);
+K_SEM_DEFINE(bluesync_auto_round_sem, 0, 1);
+K_SEM_DEFINE(bluesync_auto_listen_end_sem, 0, 1);
+
+static struct k_sem *const bluesync_event_sems[BLUESYNC_EVT_NUM] = {
+	[BLUESYNC_EVT_INIT] = &bluesync_role_assign_sem,
+	[BLUESYNC_EVT_NEW_NET_SYNC] = &bluesync_start_new_sync_sem,
+	[BLUESYNC_EVT_RX] = &bluesync_rx_sem,
+	[BLUESYNC_EVT_SYNC_EXPIRED] = &bluesync_end_sync_sem,
+	[BLUESYNC_EVT_ADV_SLOT] = &bluesync_adv_slot_sem,
+	[BLUESYNC_EVT_ADV_PRELOAD] = &bluesync_adv_preload_sem,
+	[BLUESYNC_EVT_RELAY_BACKOFF] = &bluesync_relay_backoff_sem,
+	[BLUESYNC_EVT_SCAN_WINDOW] = &bluesync_scan_window_sem,
+	[BLUESYNC_EVT_AUTO_ROUND] = &bluesync_auto_round_sem,
+	[BLUESYNC_EVT_AUTO_LISTEN_END] = &bluesync_auto_listen_end_sem,
+};
+#else
+static struct k_work bluesync_event_works[BLUESYNC_EVT_NUM];
+static struct k_work_q *bluesync_work_q;
+#endif
 
 static void reset_bluesync_timestamps(bluesync_timestamps_t *elem){
 	memset(&elem->bitfield, 0, sizeof(elem->bitfield));
@@ -136,9 +196,7 @@ static void add_bluesync_timestamps(bluesync_timestamps_t *elem
 	set_bit(&elem->bitfield[0], (size_t)pos);
 }
 
-static void bluesync_reset_param(){
-	param.timeslot_index = 0;
-
+static void bluesync_reset_rx_sets(){
 	k_mutex_lock(&param.local_mutex, K_FOREVER);
 	{
 		reset_bluesync_timestamps(&param.local);
@@ -147,117 +205,343 @@ static void bluesync_reset_param(){
 	k_mutex_lock(&param.rcv_mutex, K_FOREVER);
 	{
 		reset_bluesync_timestamps(&param.rcv);
+		param.rcv_delta_coded = false;
+		param.nb_sources = 0;
+#if defined(CONFIG_BLUESYNC_FAST_ACQUISITION)
+		param.acq_nb_pairs = 0;
+#endif
 	}
 	k_mutex_unlock(&param.rcv_mutex);
 }
 
+static void bluesync_reset_param(){
+#if defined(CONFIG_BLUESYNC_RELAY_PIPELINE)
+	param.relay_pipelined = false;
+#endif
+	bluesync_reset_rx_sets();
+}
+
 static bluesync_status_t calculate_lr_from_history(
     double *slope,
     double *offset,
     size_t min_nb_timestamp)
 {
+	bluesync_status_t status;
 
-    double sum_x = 0, sum_y = 0;
-    size_t n = 0;
+	k_mutex_lock(&param.history_mutex, K_FOREVER);
+	{
+		status = bluesync_estimator.estimate(param.history, param.history_count,
+						     slope, offset, min_nb_timestamp);
+	}
+	k_mutex_unlock(&param.history_mutex);
 
-    // Accumulate
-    for (int burst = 0; burst < param.rcv_count; burst++) {
-        bluesync_timestamps_t *rcv = &param.rcv_history[burst];
-        bluesync_timestamps_t *local = &param.local_history[burst];
+	return status;
+}
 
-        uint8_t burst_bitfield[NB_BYTES_BITFIELD] = {0};
-        bitwise_and_bitfields(burst_bitfield, rcv, local, NB_BYTES_BITFIELD);
+static void bluesync_store_current_burst(){
+	k_mutex_lock(&param.mutex, K_FOREVER);
+	{
+		k_mutex_lock(&param.history_mutex, K_FOREVER);
+		{
+			// Overwriting the oldest entry evicts it from the window
+			bluesync_history_store(&param.history[param.history_head],
+					       &param.rcv, &param.local);
+			if (bluesync_estimator.add_burst) {
+				bluesync_estimator.add_burst(&param.history[param.history_head]);
+			}
+			param.history_head = (param.history_head + 1) % BURST_WINDOWS_SIZE;
+			if (param.history_count < BURST_WINDOWS_SIZE) {
+				param.history_count++;
+			}
+		}
+		k_mutex_unlock(&param.history_mutex);
+	}
+	k_mutex_unlock(&param.mutex);
+}
 
-        for (int i = 0; i < SLOT_NUMBER; i++) {
-            if (is_bit_set(burst_bitfield, i)) {
-                sum_x += (double)local->timer_ticks[i];
-                sum_y += (double)rcv->timer_ticks[i];
-                n++;
-            }
-        }
-    }
+/* New role or new epoch: the stored bursts belong to the previous reference */
+static void bluesync_history_reset(){
+	k_mutex_lock(&param.history_mutex, K_FOREVER);
+	{
+		param.history_head = 0;
+		param.history_count = 0;
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+		param.quality_slope_ticks = 0.0;
+#endif
+		if (bluesync_estimator.reset) {
+			bluesync_estimator.reset();
+		}
+	}
+	k_mutex_unlock(&param.history_mutex);
+}
 
-    if (n == 0) {
-        LOG_ERR("No valid data in history for regression.");
-        return BLUESYNC_NO_VALID_DATA_STATUS;
-    } else if (n < min_nb_timestamp) {
-        LOG_ERR("Not enough valid samples in history (min = %zu, got = %zu)", min_nb_timestamp, n);
-        return BLUESYNC_NO_ENOUGH_DATA_STATUS;
-    }
+/* Version 3 rounds: the master timestamps after slot 0 are relative to it */
+static void bluesync_resolve_rcv_deltas(){
+	k_mutex_lock(&param.rcv_mutex, K_FOREVER);
+	{
+		if (param.rcv_delta_coded) {
+			bluesync_msg_resolve_deltas(&param.rcv);
+			param.rcv_delta_coded = false;
+		}
+	}
+	k_mutex_unlock(&param.rcv_mutex);
+}
 
-    double mean_x = sum_x / n;
-    double mean_y = sum_y / n;
+static void bluesync_apply_correction(double slope_ticks, double offset_ticks){
+#if defined(CONFIG_BLUESYNC_RELAY_PIPELINE)
+	param.relay_synced = true;
 
-    double sum_cov = 0.0;
-    double sum_var = 0.0;
+	// The slots of a relay burst must all be stamped with the same correction
+	if (param.adv_burst_running) {
+		param.pending_slope = slope_ticks;
+		param.pending_offset = offset_ticks;
+		param.correction_pending = true;
+		return;
+	}
+#endif
+	apply_timer_sync(slope_ticks, offset_ticks);
+}
 
-    // Now second pass: accumulate covariance and variance
-    for (int burst = 0; burst < param.rcv_count; burst++) {
-        bluesync_timestamps_t *rcv = &param.rcv_history[burst];
-        bluesync_timestamps_t *local = &param.local_history[burst];
+/*
+ * Bursts of the round being received, one per advertiser: relays in range
+ * send the same round on their own timeline, which must not be mixed.
+ * Guarded by rcv_mutex.
+ */
+static struct bluesync_source *bluesync_source_get(const bt_addr_le_t *addr){
+	for (int i = 0; i < param.nb_sources; i++) {
+		if (bt_addr_le_eq(&param.sources[i].addr, addr)) {
+			return &param.sources[i];
+		}
+	}
 
-        uint8_t burst_bitfield[NB_BYTES_BITFIELD] = {0};
-        bitwise_and_bitfields(burst_bitfield, rcv, local, NB_BYTES_BITFIELD);
+	if (param.nb_sources == BLUESYNC_SOURCES_MAX) {
+		return NULL;
+	}
 
-        for (int i = 0; i < SLOT_NUMBER; i++) {
-            if (is_bit_set(burst_bitfield, i)) {
-                double x = (double)local->timer_ticks[i] - mean_x;
-                double y = (double)rcv->timer_ticks[i] - mean_y;
-                sum_cov += x * y;
-                sum_var += x * x;
-            }
-        }
-    }
+	struct bluesync_source *src = &param.sources[param.nb_sources++];
 
-    if (fabs(sum_var) < 1e-12) {
-        LOG_ERR("Variance too small → numerical instability (%e)", sum_var);
-        return BLUESYNC_DENOMINATOR_TOO_SMALL;
-    }
+	memset(src, 0, sizeof(*src));
+	bt_addr_le_copy(&src->addr, addr);
+	return src;
+}
 
-    *slope = sum_cov / sum_var;
-    *offset = mean_y - (*slope * mean_x);
+/* Pairs left for the regression once bluesync_resolve_rcv_deltas() has run */
+static size_t bluesync_source_nb_pairs(struct bluesync_source *src){
+	uint8_t valid[NB_BYTES_BITFIELD];
 
-    return BLUESYNC_SUCCESS_STATUS;
-}
+	if (src->rcv_delta_coded && !is_bit_set(src->rcv.bitfield, 0)) {
+		return 0;
+	}
 
-static void bluesync_decode_msg(struct bluesync_msg_client *msg, struct net_buf_simple *buf){
-	msg->client_timer_ticks = k_uptime_ticks();
-	msg->rcv.round_id = net_buf_simple_pull_u8(buf);
-	msg->rcv.index_timeslot = net_buf_simple_pull_u8(buf);
-	msg->rcv.master_timer_ticks = net_buf_simple_pull_le64(buf);
-#if defined(CONFIG_BLUESYNC_TEST_BABBLESIM_SUPPORT)
-	msg->master_estimation_ticks = get_logical_time_ticks();
-#endif
+	bitwise_and_bitfields(valid, &src->rcv, &src->local, NB_BYTES_BITFIELD);
+	return count_set_bits(valid, NB_BYTES_BITFIELD);
 }
 
-static void bluesync_store_current_burst(){
-	k_mutex_lock(&param.mutex, K_FOREVER);
+/*
+ * The burst of the round is the one of the source with the most pairs or,
+ * with CONFIG_BLUESYNC_SOURCE_SELECTION, of the cheapest source among
+ * those with enough pairs for the update. It is copied to rcv and local,
+ * the rest of the update is unchanged.
+ */
+static void bluesync_select_source(){
+	k_mutex_lock(&param.rcv_mutex, K_FOREVER);
 	{
-		k_mutex_lock(&param.rcv_history_mutex, K_FOREVER);
-		{
-			param.rcv_history[param.rcv_head] = param.rcv;
-			param.rcv_head = (param.rcv_head + 1) % BURST_WINDOWS_SIZE;
-			if (param.rcv_count < BURST_WINDOWS_SIZE) {
-				param.rcv_count++;
+		struct bluesync_source *best = NULL;
+		size_t best_pairs = 0;
+
+		for (int i = 0; i < param.nb_sources; i++) {
+			struct bluesync_source *src = &param.sources[i];
+			size_t pairs = bluesync_source_nb_pairs(src);
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+			bool enough = (pairs >= SLOT_NUMBER / 2);
+			bool best_enough = (best_pairs >= SLOT_NUMBER / 2);
+
+			if (best == NULL || (enough && (!best_enough || src->cost < best->cost)) ||
+			    (!enough && !best_enough && pairs > best_pairs)) {
+#else
+			if (best == NULL || pairs > best_pairs) {
+#endif
+				best = src;
+				best_pairs = pairs;
 			}
 		}
-		k_mutex_unlock(&param.rcv_history_mutex);
 
-		k_mutex_lock(&param.local_history_mutex, K_FOREVER);
-		{
-			param.local_history[param.local_head] = param.local;
-			param.local_head = (param.local_head + 1) % BURST_WINDOWS_SIZE;
-			if (param.local_count < BURST_WINDOWS_SIZE) {
-				param.local_count++;
+		if (best != NULL) {
+			param.rcv = best->rcv;
+			param.rcv_delta_coded = best->rcv_delta_coded;
+			k_mutex_lock(&param.local_mutex, K_FOREVER);
+			{
+				param.local = best->local;
 			}
+			k_mutex_unlock(&param.local_mutex);
+			bt_addr_le_copy(&param.sync_src, &best->addr);
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+			param.sync_src_hop = best->hop;
+			param.sync_src_uncertainty_us = best->uncertainty_us;
+#endif
+		}
+
+		if (param.nb_sources > 1) {
+			LOG_DBG("Round %u received from %u sources, %u pairs kept", param.new_round_id,
+				param.nb_sources, (unsigned int)best_pairs);
 		}
-		k_mutex_unlock(&param.local_history_mutex);
 	}
-	k_mutex_unlock(&param.mutex);
+	k_mutex_unlock(&param.rcv_mutex);
+}
+
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION) || defined(CONFIG_BLUESYNC_SCHEDULED_SCAN)
+/*
+ * Residual RMS of the last burst against a correction, in us, and the
+ * local time spanned by the window of bursts, in ticks
+ */
+static double bluesync_history_rms_us(double slope_ticks, double offset_ticks, uint64_t *span_ticks){
+	double rms_ticks;
+
+	k_mutex_lock(&param.history_mutex, K_FOREVER);
+	{
+		size_t last = (param.history_head + BURST_WINDOWS_SIZE - 1) % BURST_WINDOWS_SIZE;
+		size_t oldest = (param.history_head + BURST_WINDOWS_SIZE - param.history_count) % BURST_WINDOWS_SIZE;
+
+		rms_ticks = bluesync_history_residual_rms(&param.history[last], slope_ticks, offset_ticks);
+		// Bursts without pairs have no origin
+		*span_ticks = param.history[last].stats.n == 0 || param.history[oldest].stats.n == 0 ? 0 :
+			      param.history[last].stats.origin_x - param.history[oldest].stats.origin_x;
+	}
+	k_mutex_unlock(&param.history_mutex);
+
+	return rms_ticks * 1e6 / bluesync_time_source_hz();
+}
+#endif
+
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+/*
+ * Quality advertised from now on: one hop more than the source, and added
+ * to its uncertainty the residual RMS of the burst and the skew error.
+ * The latter is the change of slope since the previous update over one
+ * round period: the time error the previous slope made until this round.
+ * It grows with the period and after a temperature swing.
+ */
+static void bluesync_update_quality(double slope_ticks, double offset_ticks){
+	uint64_t span_ticks;
+	double rms_us = bluesync_history_rms_us(slope_ticks, offset_ticks, &span_ticks);
+	double skew_us = 0.0;
+
+	// Average period of the rounds of the window
+	if (param.quality_slope_ticks != 0.0 && span_ticks != 0 && param.history_count > 1) {
+		double period_us = (double)span_ticks * 1e6 / bluesync_time_source_hz() /
+				   (param.history_count - 1);
+
+		skew_us = fabs(slope_ticks - param.quality_slope_ticks) * period_us;
+	}
+	param.quality_slope_ticks = slope_ticks;
+
+	if (param.sync_src_hop >= BLUESYNC_HOP_UNKNOWN - 1 ||
+	    param.sync_src_uncertainty_us == BLUESYNC_UNCERTAINTY_UNKNOWN) {
+		param.hop = BLUESYNC_HOP_UNKNOWN;
+		param.uncertainty_us = BLUESYNC_UNCERTAINTY_UNKNOWN;
+		return;
+	}
+
+	double src_us = param.sync_src_uncertainty_us;
+	double uncertainty_us = sqrt(src_us * src_us + rms_us * rms_us + skew_us * skew_us);
+
+	param.hop = param.sync_src_hop + 1;
+	param.uncertainty_us = (uint16_t)MIN(lround(uncertainty_us), BLUESYNC_UNCERTAINTY_UNKNOWN - 1);
+	LOG_DBG("Hop %u, uncertainty %u us (skew %d us)", param.hop, param.uncertainty_us,
+		(int)lround(skew_us));
+}
+#endif
+
+#if defined(CONFIG_BLUESYNC_SCHEDULED_SCAN)
+/*
+ * Error of the own estimate, for the scan guard: the time error (the
+ * advertised uncertainty with source selection, the residual RMS
+ * otherwise), and the skew error, taken as the residual RMS over the
+ * span of the window. Must run after bluesync_update_quality().
+ */
+static void bluesync_scan_error_update(double slope_ticks, double offset_ticks){
+	uint64_t span_ticks;
+	double rms_us = bluesync_history_rms_us(slope_ticks, offset_ticks, &span_ticks);
+	double error_us = rms_us;
+
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	if (param.uncertainty_us != BLUESYNC_UNCERTAINTY_UNKNOWN) {
+		error_us = param.uncertainty_us;
+	}
+#endif
+	param.scan_error_us = (uint32_t)lround(error_us);
+
+	// Single burst: no skew error known, the configured drift applies
+	double span_us = (double)span_ticks * 1e6 / bluesync_time_source_hz();
+
+	param.scan_skew_ppb = span_ticks == 0 ? 0 : (uint32_t)MIN(lround(rms_us / span_us * 1e9), UINT32_MAX);
+	LOG_DBG("Scan guard error %u us, %u ppb", param.scan_error_us, param.scan_skew_ppb);
+}
+#endif
+
+/* The lock state only rises, the time of each step is the acquisition time after boot */
+static void bluesync_lock_raise(bluesync_lock_state_t state){
+	if (state <= (bluesync_lock_state_t)atomic_get(&lock_state)) {
+		return;
+	}
+
+	atomic_set(&lock_state, state);
+	LOG_INF("Lock state %d after %lld ms", state, k_uptime_get());
+	if (lock_cb != NULL) {
+		lock_cb(state);
+	}
 }
 
+#if defined(CONFIG_BLUESYNC_CALIBRATION_STORE)
+/*
+ * Warm start: until a full lock, the slope is pulled towards the stored
+ * calibration, the more as the record is recent and the history short.
+ * The line still goes through the mean of the last burst. Once locked,
+ * the slope is stored.
+ */
+static void bluesync_calib_process(double *slope_ticks, double *offset_ticks){
+	struct bluesync_burst_stats stats;
+
+	k_mutex_lock(&param.history_mutex, K_FOREVER);
+	{
+		size_t last = (param.history_head + BURST_WINDOWS_SIZE - 1) % BURST_WINDOWS_SIZE;
+
+		stats = param.history[last].stats;
+	}
+	k_mutex_unlock(&param.history_mutex);
+
+	if (stats.n == 0) {
+		return;
+	}
+
+	if (param.history_count >= BLUESYNC_LOCK_BURSTS) {
+		bluesync_calib_update(*slope_ticks, stats.origin_y);
+		return;
+	}
+
+	double prior;
+	double weight = bluesync_calib_prior(stats.origin_y, &prior);
+
+	if (weight <= 0.0) {
+		return;
+	}
+
+	weight *= (double)(BLUESYNC_LOCK_BURSTS - param.history_count) / BLUESYNC_LOCK_BURSTS;
+	*slope_ticks = weight * prior + (1.0 - weight) * *slope_ticks;
+
+	double mean_x = (double)stats.origin_x + (double)stats.sum_dx / stats.n;
+	double mean_y = (double)stats.origin_y + (double)stats.sum_dy / stats.n;
+
+	*offset_ticks = mean_y - *slope_ticks * mean_x;
+	LOG_DBG("Stored slope used with weight %d%%", (int)lround(weight * 100.0));
+}
+#endif
+
 static bluesync_status_t end_sync_timeslot_process() {
 	LOG_DBG("method: %s", __func__);
+
+	bluesync_select_source();
+	bluesync_resolve_rcv_deltas();
 	
 #if defined(CONFIG_BLUESYNC_TEST_BABBLESIM_SUPPORT)
 	statistic_bluesync_status(&param.rcv, &param.local, SLOT_NUMBER);
@@ -276,7 +560,21 @@ static bluesync_status_t end_sync_timeslot_process() {
 		return err;
 	}
 
-	apply_timer_sync(slope_ticks, offset_ticks);
+#if defined(CONFIG_BLUESYNC_CALIBRATION_STORE)
+	bluesync_calib_process(&slope_ticks, &offset_ticks);
+#endif
+	bluesync_apply_correction(slope_ticks, offset_ticks);
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	bluesync_update_quality(slope_ticks, offset_ticks);
+#endif
+#if defined(CONFIG_BLUESYNC_SCHEDULED_SCAN)
+	bluesync_scan_error_update(slope_ticks, offset_ticks);
+#endif
+#if defined(CONFIG_BLUESYNC_FAST_ACQUISITION)
+	param.acq_done = true;
+#endif
+	bluesync_lock_raise(param.history_count >= BLUESYNC_LOCK_BURSTS ?
+			    BLUESYNC_LOCK_FULL : BLUESYNC_LOCK_SKEW);
 
 	k_mutex_lock(&param.mutex, K_FOREVER);
 	{
@@ -287,21 +585,199 @@ static bluesync_status_t end_sync_timeslot_process() {
 }
 
 void drift_estimation_handler(struct k_timer *timer_id){
-	k_sem_give(&bluesync_end_sync_sem);
+	bluesync_post(BLUESYNC_EVT_SYNC_EXPIRED);
+}
+
+static void bluesync_adv_process(uint8_t round_id);
+
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+/*
+ * Expected error of a source, in microseconds: its advertised
+ * uncertainty, a fixed cost per hop, and a cost per dB below the RSSI
+ * floor, where losses and timestamping noise grow.
+ */
+static uint32_t bluesync_source_cost(const struct bluesync_msg_client *msg){
+	uint32_t cost = msg->uncertainty_us + (uint32_t)msg->hop * CONFIG_BLUESYNC_SOURCE_HOP_COST_US;
+
+	if (msg->rssi < CONFIG_BLUESYNC_SOURCE_RSSI_FLOOR) {
+		cost += (uint32_t)(CONFIG_BLUESYNC_SOURCE_RSSI_FLOOR - msg->rssi) *
+			CONFIG_BLUESYNC_SOURCE_RSSI_COST_US;
+	}
+
+	return cost;
 }
+#endif
 
-static void bluesync_scan_packet_process(){
-	struct bluesync_msg_client msg;
-	int ret = k_msgq_get(&bluesync_rx_msgq, &msg, K_FOREVER);
-    if (ret != 0) {
-		LOG_ERR("No message available (err: %d)", ret);
+#if defined(CONFIG_BLUESYNC_RELAY_PIPELINE)
+/*
+ * Cut-through relaying: once CONFIG_BLUESYNC_RELAY_PIPELINE_SLOTS slots of
+ * the round are in, the relay burst is started, stamped with the logical
+ * clock of the previous rounds, while the rest of the round is still
+ * received. A node never updated has nothing to relay yet.
+ */
+static void bluesync_relay_pipeline_start(uint8_t current_timeslot_idx){
+	if (!param.relay_synced || param.relay_pipelined ||
+	    current_timeslot_idx < CONFIG_BLUESYNC_RELAY_PIPELINE_SLOTS ||
+	    bs_state_machine_get_state() != BS_SYNC) {
 		return;
-    }
+	}
+
+	LOG_DBG("Relaying round %u from slot %u", param.new_round_id, current_timeslot_idx);
+	param.relay_pipelined = true;
+	bluesync_adv_process(param.new_round_id);
+}
+#endif
+
+#if defined(CONFIG_BLUESYNC_RELAY_SUPPRESSION)
+/*
+ * During the relay backoff: a neighbour relaying the round just synced,
+ * other than the source kept for it, covers about the same area. With
+ * CONFIG_BLUESYNC_SOURCE_SELECTION, only the ones at most as deep count.
+ */
+static void bluesync_relay_suppression_hear(const struct bluesync_msg_client *msg){
+	if (!param.relay_backoff || msg->rcv.round_id != param.current_round_id ||
+	    bt_addr_le_eq(&msg->addr, &param.sync_src)) {
+		return;
+	}
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	if (msg->hop > param.hop) {
+		return;
+	}
+#endif
+
+	for (int i = 0; i < param.relay_heard; i++) {
+		if (bt_addr_le_eq(&param.relay_heard_addr[i], &msg->addr)) {
+			return;
+		}
+	}
+
+	if (param.relay_heard < CONFIG_BLUESYNC_RELAY_SUPPRESSION_K) {
+		bt_addr_le_copy(&param.relay_heard_addr[param.relay_heard++], &msg->addr);
+	}
+}
+#endif
+
+#if defined(CONFIG_BLUESYNC_AUTO_ROUNDS)
+/* Authority: uncertainty advertised by the hop 1 relays of the last round */
+static void bluesync_auto_hear(const struct bluesync_msg_client *msg){
+	if (!param.auto_listening || msg->rcv.round_id != param.current_round_id || msg->hop != 1) {
+		return;
+	}
+
+	param.auto_nb_heard++;
+	param.auto_worst_us = MAX(param.auto_worst_us, msg->uncertainty_us);
+}
+#endif
+
+#if defined(CONFIG_BLUESYNC_FAST_ACQUISITION)
+/*
+ * Each packet only refines the fit of the round a little. Its correction
+ * is applied when it reaches a higher lock state, or moves the time by
+ * more than CONFIG_BLUESYNC_FAST_ACQ_MIN_CHANGE_US: every correction is a
+ * step or a slew, and with CONFIG_BLUESYNC_TIME_MAP takes a map entry.
+ */
+static void bluesync_acquisition_apply(bluesync_lock_state_t state, double slope_ticks,
+				       double offset_ticks){
+	if (state <= (bluesync_lock_state_t)atomic_get(&lock_state)) {
+		double cur_slope;
+		double cur_offset;
+
+		get_current_slope_offset_ticks(&cur_slope, &cur_offset);
+
+		// A client corrects the uptime itself, its reference is 0
+		double moved_ticks = (slope_ticks - cur_slope) * (double)bluesync_time_source_get() +
+				     offset_ticks - cur_offset;
+
+		if (fabs(moved_ticks) * 1e6 / bluesync_time_source_hz() <=
+		    CONFIG_BLUESYNC_FAST_ACQ_MIN_CHANGE_US) {
+			return;
+		}
+	}
+
+	apply_timer_sync(slope_ticks, offset_ticks);
+}
+
+/*
+ * Until the first update, the best burst of the round is fitted after
+ * each packet bringing it a new pair: offset only while the pairs are
+ * too few or too close for the skew, offset and skew afterwards.
+ * Called with rcv_mutex held, returns the lock state reached.
+ */
+static bluesync_lock_state_t bluesync_acquisition_process(struct bluesync_source *src){
+	size_t pairs = bluesync_source_nb_pairs(src);
+
+	if (param.acq_done || pairs <= param.acq_nb_pairs) {
+		return BLUESYNC_LOCK_NONE;
+	}
+	param.acq_nb_pairs = pairs;
+
+	param.acq_rcv = src->rcv;
+	if (src->rcv_delta_coded) {
+		bluesync_msg_resolve_deltas(&param.acq_rcv);
+	}
+	bluesync_history_store(&param.acq_burst, &param.acq_rcv, &src->local);
+
+	const struct bluesync_burst_stats *stats = &param.acq_burst.stats;
+
+	if (stats->n == 0) {
+		return BLUESYNC_LOCK_NONE;
+	}
+
+	double slope_ticks;
+	double offset_ticks;
+
+	if (stats->n >= CONFIG_BLUESYNC_FAST_ACQ_SKEW_PAIRS &&
+	    bluesync_regression_from_stats(&param.acq_burst, 1, &slope_ticks, &offset_ticks,
+					   CONFIG_BLUESYNC_FAST_ACQ_SKEW_PAIRS) == BLUESYNC_SUCCESS_STATUS) {
+		if (fabs(slope_ticks - 1.0) <= CONFIG_BLUESYNC_FAST_ACQ_MAX_SKEW_PPM * 1e-6) {
+			bluesync_acquisition_apply(BLUESYNC_LOCK_SKEW, slope_ticks, offset_ticks);
+			return BLUESYNC_LOCK_SKEW;
+		}
+		LOG_DBG("Acquisition skew discarded (%d ppm)", (int)lround((slope_ticks - 1.0) * 1e6));
+	}
+
+	slope_ticks = 1.0;
+#if defined(CONFIG_BLUESYNC_CALIBRATION_STORE)
+	double prior;
+
+	if (bluesync_calib_prior(stats->origin_y, &prior) > 0.0) {
+		slope_ticks = prior;
+	}
+#endif
+
+	// Line of that slope through the mean of the pairs
+	double mean_dx = (double)stats->sum_dx / stats->n;
+	double mean_dy = (double)stats->sum_dy / stats->n;
+
+	offset_ticks = (double)(int64_t)(stats->origin_y - stats->origin_x) + mean_dy - mean_dx -
+		       (slope_ticks - 1.0) * ((double)stats->origin_x + mean_dx);
+	bluesync_acquisition_apply(BLUESYNC_LOCK_OFFSET, slope_ticks, offset_ticks);
+	return BLUESYNC_LOCK_OFFSET;
+}
+#endif
 
-	uint8_t current_round_id = msg.rcv.round_id;
-	uint8_t current_timeslot_idx = msg.rcv.index_timeslot;
+static void bluesync_scan_packet_process(const struct bluesync_msg_client *msg){
+	uint8_t current_round_id = msg->rcv.round_id;
+	uint8_t current_timeslot_idx = msg->rcv.index_timeslot;
 
 	bs_sm_state_t current_state = bs_state_machine_get_state();
+#if defined(CONFIG_BLUESYNC_FAST_ACQUISITION)
+	bluesync_lock_state_t acq_state = BLUESYNC_LOCK_NONE;
+#endif
+
+#if defined(CONFIG_BLUESYNC_AUTO_ROUNDS)
+	if (current_state == BS_STOP) {
+		bluesync_auto_hear(msg);
+		return;
+	}
+#endif
+
+#if defined(CONFIG_BLUESYNC_RELAY_SUPPRESSION)
+	if (current_state == BS_ADV) {
+		bluesync_relay_suppression_hear(msg);
+		return;
+	}
+#endif
 
 	if (current_state == BS_SCAN_WAIT_FOR_SYNC)
 	{
@@ -313,6 +789,9 @@ static void bluesync_scan_packet_process(){
 			param.new_round_id = current_round_id;
 		}
 		k_mutex_unlock(&param.mutex);
+#if defined(CONFIG_BLUESYNC_SCHEDULED_SCAN)
+		bluesync_scan_round_start(msg);
+#endif
 
 		int remaining_slots = BLUESYNC_TIMESTAMP_ARRAY_SIZE + 1 - current_timeslot_idx;
 		k_timer_start(&param.drift_estimation_timer, K_MSEC(remaining_slots * CONFIG_BLUESYNC_ADV_INT_MS), K_NO_WAIT);
@@ -320,153 +799,291 @@ static void bluesync_scan_packet_process(){
 		bs_state_machine_run(EVENT_NEW_SYNC_RCV);
 
 	}
+	else if (current_round_id != param.new_round_id) {
+		return;
+	}
 	
 	if(current_timeslot_idx > SLOT_NUMBER){
 		LOG_ERR("Index too large: %u (max %u)", current_timeslot_idx, SLOT_NUMBER);
 		return;
 	}
 
-	// add timestamp to local set if index is between the range
-	if(current_timeslot_idx >= 0  && current_timeslot_idx < SLOT_NUMBER){
-		k_mutex_lock(&param.local_mutex, K_FOREVER);
-		{
-			add_bluesync_timestamps(&param.local 
+	k_mutex_lock(&param.rcv_mutex, K_FOREVER);
+	{
+		struct bluesync_source *src = bluesync_source_get(&msg->addr);
+
+		if (src == NULL) {
+			atomic_inc(&rx_untracked);
+			k_mutex_unlock(&param.rcv_mutex);
+			return;
+		}
+
+		// add timestamp to local set if index is between the range,
+		// the first packet of a slot is kept
+		if(current_timeslot_idx < SLOT_NUMBER){
+			if (is_bit_set(src->local.bitfield, current_timeslot_idx)) {
+				atomic_inc(&rx_duplicates);
+				k_mutex_unlock(&param.rcv_mutex);
+				return;
+			}
+			add_bluesync_timestamps(&src->local 
 									, current_timeslot_idx 
-									, msg.client_timer_ticks
+									, msg->client_timer_ticks
 #if defined(CONFIG_BLUESYNC_TEST_BABBLESIM_SUPPORT)
-									, msg.master_estimation_ticks
+									, msg->master_estimation_ticks
 #endif
 									);
 		}
-		k_mutex_unlock(&param.local_mutex);
-	}
 
-	// add timestamp to master set if index is between the range
-	if(current_timeslot_idx >= 1  && current_timeslot_idx <= SLOT_NUMBER){
-		k_mutex_lock(&param.rcv_mutex, K_FOREVER);
-		{
-			add_bluesync_timestamps(&param.rcv
+		// add timestamp to master set if index is between the range
+		if(current_timeslot_idx >= 1  && current_timeslot_idx <= SLOT_NUMBER){
+			src->rcv_delta_coded |= msg->delta_coded;
+			add_bluesync_timestamps(&src->rcv
 									, current_timeslot_idx-1
-									, msg.rcv.master_timer_ticks
+									, msg->rcv.master_timer_ticks
 #if defined(CONFIG_BLUESYNC_TEST_BABBLESIM_SUPPORT)
 									, 0
 #endif														
 									);
 		}
-		k_mutex_unlock(&param.rcv_mutex);
-	}
-}
-
-static uint8_t bt_packet_buf[sizeof(uint16_t) + sizeof(struct bluesync_msg)] = {0};
-
-static bluesync_status_t bluesync_encode_msg(struct bt_data *bt_pkt, uint8_t current_round_id, 
-	uint8_t current_timeslot_idx, 
-	int64_t time_ticks){
-
-	memset(bt_packet_buf, 0, sizeof(bt_packet_buf));
 
-	struct bluesync_msg msg = {
-		.round_id = current_round_id,
-		.index_timeslot = current_timeslot_idx,
-		.master_timer_ticks = time_ticks
-	};
+#if BLUESYNC_MSG_FOLLOW_UP_COUNT > 1
+		// Recover the master timestamps of the slots whose next packet was lost
+		for (int i = 0; i < msg->nb_follow_up; i++) {
+			int slot = current_timeslot_idx - 2 - i;
 
-	uint16_t manufacturer_id = MY_MANUFACTURER_ID;
+			if (slot < 0) {
+				break;
+			}
+			if (slot < SLOT_NUMBER) {
+				add_bluesync_timestamps(&src->rcv
+										, slot
+										, msg->follow_up_ticks[i]
+#if defined(CONFIG_BLUESYNC_TEST_BABBLESIM_SUPPORT)
+										, 0
+#endif
+										);
+			}
+		}
+#endif
+
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+		src->cost = bluesync_source_cost(msg);
+		src->hop = msg->hop;
+		src->uncertainty_us = msg->uncertainty_us;
+#endif
+#if defined(CONFIG_BLUESYNC_FAST_ACQUISITION)
+		acq_state = bluesync_acquisition_process(src);
+#endif
+	}
+	k_mutex_unlock(&param.rcv_mutex);
+
+#if defined(CONFIG_BLUESYNC_FAST_ACQUISITION)
+	bluesync_lock_raise(acq_state);
+#endif
+
+#if defined(CONFIG_BLUESYNC_RELAY_PIPELINE)
+	bluesync_relay_pipeline_start(current_timeslot_idx);
+#endif
+}
+
+static void bluesync_scan_ring_process(){
+	static atomic_val_t reported_overruns;
+	struct bluesync_msg_client *msg;
+
+	// One semaphore give may cover several messages
+	while ((msg = bluesync_rx_ring_peek(&bluesync_rx_ring)) != NULL) {
+		bluesync_scan_packet_process(msg);
+		bluesync_rx_ring_release(&bluesync_rx_ring);
+	}
+
+	atomic_val_t overruns = atomic_get(&bluesync_rx_ring.overruns);
+	if (overruns != reported_overruns) {
+		LOG_WRN("RX ring full, %ld messages dropped", (long)(overruns - reported_overruns));
+		reported_overruns = overruns;
+	}
+}
+
+static uint8_t bt_packet_buf[sizeof(uint16_t) + BLUESYNC_MSG_MAX_SIZE] = {0};
+
+static bluesync_status_t bluesync_encode_msg(struct bt_data *bt_pkt, uint8_t current_round_id, 
+	uint8_t current_timeslot_idx, 
+	const uint64_t *tx_ticks){
+	uint16_t manufacturer_id = MY_MANUFACTURER_ID;
+	uint8_t hop = 0;
+	uint16_t uncertainty_us = 0;
     
     // Copy Manufacturer ID (Little Endian format)
     bt_packet_buf[0] = manufacturer_id & 0xFF;
     bt_packet_buf[1] = (manufacturer_id >> 8) & 0xFF;
-    
-    // Copy the struct data into the buffer
-    memcpy(&bt_packet_buf[2], &msg, sizeof(struct bluesync_msg));
+
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	hop = param.hop;
+	uncertainty_us = param.uncertainty_us;
+#endif
+	size_t len = sizeof(uint16_t) + bluesync_msg_encode(&bt_packet_buf[2], current_round_id,
+							    current_timeslot_idx, tx_ticks,
+							    hop, uncertainty_us);
 
 	bt_pkt[0].type = BT_DATA_FLAGS;
 	bt_pkt[0].data_len = 1;
 	bt_pkt[0].data = (uint8_t []) { BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR };
 
 	bt_pkt[1].type = BT_DATA_MANUFACTURER_DATA;
-	bt_pkt[1].data_len = sizeof(bt_packet_buf);
+	bt_pkt[1].data_len = len;
 	bt_pkt[1].data = bt_packet_buf;
 
 	return BLUESYNC_SUCCESS_STATUS;
 }
 
-static void bluesync_send_adv(){
+static int bluesync_set_adv_data(){
 	struct bt_data bt_packet[2];
 
-	if (param.timeslot_index == 0){
-		bluesync_encode_msg(bt_packet, param.current_round_id, param.timeslot_index, 0);
-	} 
-	else {
-		bluesync_encode_msg(bt_packet, param.current_round_id, param.timeslot_index,
-							param.local.timer_ticks[param.timeslot_index-1]);
-	}
+	bluesync_encode_msg(bt_packet, param.adv_round_id, param.timeslot_index,
+						param.tx_ticks);
 
 	int err = bt_le_ext_adv_set_data(param.adv, bt_packet, ARRAY_SIZE(bt_packet), NULL, 0);
     if (err) {
         LOG_ERR("Failed to set advertising data (err %d)", err);
-        return;
     }
+	return err;
+}
 
+static void bluesync_send_adv(){
 	struct bt_le_ext_adv_start_param start = {
 		.num_events = 1,
 	};
 
+#if defined(CONFIG_BLUESYNC_ADV_PRELOAD)
+	// The payload was set as soon as the previous slot was sent
+	if (!param.adv_preloaded && bluesync_set_adv_data() != 0) {
+		return;
+	}
+	param.adv_preloaded = false;
+#else
+	if (bluesync_set_adv_data() != 0) {
+		return;
+	}
+
 #if defined(CONFIG_BLUESYNC_USED_IN_MESH)
 	bt_mesh_scan_disable();
+#endif
 #endif
 	
-	err = bt_le_ext_adv_start(param.adv, &start);
+	int err = bt_le_ext_adv_start(param.adv, &start);
     if (err) {
         LOG_ERR("Failed to start extended advertising (err %d)", err);
         return;
     }
 }
 
-// SCANNING PART ********************************************
-
-void scan_cb(const bt_addr_le_t *addr, int8_t rssi, struct net_buf_simple *buf){
+#if defined(CONFIG_BLUESYNC_ADV_PRELOAD)
+/* Called by the thread after the sent callback of a slot */
+static void bluesync_adv_preload(){
+	uint8_t sent;
 
-	// Check if there is enough data in the buffer
-	if (buf->len < 2) {
-		LOG_ERR("Error: Not enough data for extended advertising");
-		return;
-	}
-	// Parse length and type fields
-	// Parse AD_ELEMENT_FLAG
-	uint8_t len_ad_flag = net_buf_simple_pull_u8(buf);
-	if (len_ad_flag > 0){
-		net_buf_simple_pull_mem(buf, len_ad_flag);
+	k_mutex_lock(&param.mutex, K_FOREVER);
+	{
+		sent = param.timeslot_index;
 	}
-	// Parse AD_ELEMENT_MANUFACTURER_SPECIFIC
-	uint8_t len = net_buf_simple_pull_u8(buf);
-	if (len > buf->len) {
-		LOG_ERR("Error: Buffer length mismatch");
+	k_mutex_unlock(&param.mutex);
+
+	// Only once every started slot was sent, and before the next deadline
+	if (!param.adv_burst_running || param.adv_slot > param.adv_nb_slots || sent != param.adv_slot) {
 		return;
 	}
-	uint8_t type = net_buf_simple_pull_u8(buf);
-	if (type == BT_DATA_MANUFACTURER_DATA){
-		// get manufacturer id
-		net_buf_simple_pull_be16(buf);
-		// Verify that the payload length matches the expected size
-        if (len - 3 != sizeof(struct bluesync_msg)) {
-            LOG_ERR("Error: Unexpected manufacturer data size");
-            return;
-        }
 
-        struct bluesync_msg_client msg;
+	param.adv_preloaded = (bluesync_set_adv_data() == 0);
+}
+#endif
+
+// SCANNING PART ********************************************
+
+/* Why received advertisements were not queued, see bluesync_get_rx_stats() */
+enum bluesync_rx_reject {
+	RX_REJECT_MALFORMED,
+	RX_REJECT_NO_MANUFACTURER_DATA,
+	RX_REJECT_FOREIGN_COMPANY_ID,
+	RX_REJECT_BAD_LENGTH,
+	RX_REJECT_NUM,
+};
 
-		bluesync_decode_msg(&msg, buf);
+static atomic_t rx_accepted = ATOMIC_INIT(0);
+static atomic_t rx_rejects[RX_REJECT_NUM];
 
-		int ret = k_msgq_put(&bluesync_rx_msgq, &msg, K_NO_WAIT);
+/*
+ * Single pass over the AD structures of buf, without consuming it.
+ * Returns the BlueSync payload (after the company ID) of the first
+ * manufacturer block carrying MY_MANUFACTURER_ID with a valid
+ * length, NULL otherwise with the reject reason.
+ */
+static const uint8_t *bluesync_find_payload(const struct net_buf_simple *buf, size_t *len,
+					    enum bluesync_rx_reject *reject){
+	const uint8_t *data = buf->data;
+	size_t remaining = buf->len;
 
-		if (ret != 0 ) {
-			LOG_ERR("Failed to put message in msgq");
+	*reject = RX_REJECT_NO_MANUFACTURER_DATA;
+
+	while (remaining > 0) {
+		uint8_t ad_len = data[0];
+
+		if (ad_len == 0) {
+			break; // early termination of the significant part
+		}
+		if (ad_len > remaining - 1) {
+			*reject = RX_REJECT_MALFORMED;
+			return NULL;
 		}
 
-	} else {
-		LOG_ERR("Error: Unsupported advertising data type (0x%02X)", type);
+		// ad_len covers the type, the company ID and the payload
+		if (data[1] == BT_DATA_MANUFACTURER_DATA) {
+			if (ad_len < 3 || sys_get_le16(&data[2]) != MY_MANUFACTURER_ID) {
+				*reject = RX_REJECT_FOREIGN_COMPANY_ID;
+			} else if (!bluesync_msg_valid(&data[4], ad_len - 3)) {
+				*reject = RX_REJECT_BAD_LENGTH;
+			} else {
+				*len = ad_len - 3;
+				return &data[4];
+			}
+		}
+
+		data += ad_len + 1;
+		remaining -= ad_len + 1;
 	}
+
+	return NULL;
+}
+
+void scan_cb(const bt_addr_le_t *addr, int8_t rssi, struct net_buf_simple *buf){
+	// Taken first, the parsing below must not add to the RX jitter
+	int64_t rx_ticks = bluesync_time_source_get();
+	enum bluesync_rx_reject reject;
+	size_t len;
+
+	// Foreign traffic is only counted, logging it would flood the backend
+	const uint8_t *payload = bluesync_find_payload(buf, &len, &reject);
+	if (payload == NULL) {
+		atomic_inc(&rx_rejects[reject]);
+		return;
+	}
+
+	// Decoded in place, counted as an overrun if the thread lags behind
+	struct bluesync_msg_client *msg = bluesync_rx_ring_reserve(&bluesync_rx_ring);
+	if (msg == NULL) {
+		return;
+	}
+
+	bluesync_msg_decode(msg, payload, len, rx_ticks);
+#if defined(CONFIG_BLUESYNC_TEST_BABBLESIM_SUPPORT)
+	msg->master_estimation_ticks = get_logical_time_ticks();
+#endif
+	bt_addr_le_copy(&msg->addr, addr);
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	msg->rssi = rssi;
+#endif
+	bluesync_rx_ring_commit(&bluesync_rx_ring);
+	atomic_inc(&rx_accepted);
+	bluesync_post(BLUESYNC_EVT_RX);
 }
 
 #if !defined(CONFIG_BLUESYNC_USED_IN_MESH)
@@ -506,28 +1123,421 @@ static void bluesync_scan_stop(){
 #endif
 }
 
+#if defined(CONFIG_BLUESYNC_SCHEDULED_SCAN)
+/*
+ * Scheduled scanning. Once two rounds were received, the start of the
+ * next one is predicted from their period, which already includes the
+ * hop delay of the node. While waiting, the radio is only on from a guard
+ * time before the predicted start to a guard time plus two slots after
+ * it. The guard covers the period jitter seen so far and the error of
+ * the own estimate over one period (three times the time and skew
+ * errors, at least CONFIG_BLUESYNC_SCAN_DRIFT_PPM), and grows with each
+ * missed window.
+ * After CONFIG_BLUESYNC_SCAN_MAX_MISSES missed windows in a row, the
+ * client scans continuously until the period is learnt again.
+ */
+static void scan_window_timer_handler(struct k_timer *timer){
+	bluesync_post(BLUESYNC_EVT_SCAN_WINDOW);
+}
+
+static void bluesync_scan_radio_on(){
+	if (param.scan_on_since_ms < 0) {
+		bluesync_scan_start();
+		param.scan_on_since_ms = k_uptime_get();
+	}
+}
+
+static void bluesync_scan_radio_account(){
+	if (param.scan_on_since_ms >= 0) {
+		atomic_add(&scan_on_ms, (atomic_val_t)(k_uptime_get() - param.scan_on_since_ms));
+		param.scan_on_since_ms = -1;
+	}
+}
+
+static void bluesync_scan_radio_off(){
+	if (param.scan_on_since_ms >= 0) {
+		bluesync_scan_stop();
+		bluesync_scan_radio_account();
+	}
+}
+
+static void bluesync_scan_window_process();
+
+static void bluesync_scan_schedule(){
+	if (param.scan_period_ms == 0 || param.scan_misses >= CONFIG_BLUESYNC_SCAN_MAX_MISSES) {
+		bluesync_scan_radio_on();
+		return;
+	}
+
+	int64_t now = k_uptime_get();
+	int64_t error_us = 3 * ((int64_t)param.scan_error_us +
+				param.scan_period_ms * param.scan_skew_ppb / 1000000);
+	int64_t drift = MAX(param.scan_period_ms * CONFIG_BLUESYNC_SCAN_DRIFT_PPM / 1000000,
+			    DIV_ROUND_UP(error_us, 1000));
+	int64_t guard = (CONFIG_BLUESYNC_SCAN_GUARD_MS + 4 * param.scan_jitter_ms + drift) *
+			(1 + param.scan_misses);
+	int64_t next = param.scan_round_start_ms + param.scan_period_ms;
+
+	// Rounds whose window already closed, while this node was busy
+	while (next + guard + 2 * CONFIG_BLUESYNC_ADV_INT_MS <= now) {
+		next += param.scan_period_ms;
+	}
+
+	param.scan_next_ms = next;
+	param.scan_guard_ms = guard;
+	param.scan_window_open = false;
+
+	if (next - guard <= now) {
+		bluesync_scan_window_process();
+		return;
+	}
+
+	bluesync_scan_radio_off();
+	k_timer_start(&param.scan_window_timer, K_MSEC(next - guard - now), K_NO_WAIT);
+}
+
+static void bluesync_scan_window_process(){
+	if (bs_state_machine_get_state() != BS_SCAN_WAIT_FOR_SYNC) {
+		param.scan_window_open = false;
+		return;
+	}
+
+	if (!param.scan_window_open) {
+		param.scan_window_open = true;
+		bluesync_scan_radio_on();
+		k_timer_start(&param.scan_window_timer,
+			      K_MSEC(MAX(param.scan_next_ms + param.scan_guard_ms +
+					 2 * CONFIG_BLUESYNC_ADV_INT_MS - k_uptime_get(), 0)),
+			      K_NO_WAIT);
+		return;
+	}
+
+	// Closed without the round
+	param.scan_misses++;
+	atomic_inc(&scan_missed_windows);
+	if (param.scan_misses == CONFIG_BLUESYNC_SCAN_MAX_MISSES) {
+		LOG_WRN("%u scan windows missed, scanning continuously", param.scan_misses);
+	}
+	bluesync_scan_schedule();
+}
+
+/* First packet of a round: learn its start and the period of the rounds */
+static void bluesync_scan_round_start(const struct bluesync_msg_client *msg){
+	int64_t now = k_uptime_get();
+	// Dated from its reception, not from when the ring handed it over
+	int64_t age_ticks = bluesync_time_source_get() - msg->client_timer_ticks;
+	int64_t rx_ms = now - age_ticks * MSEC_PER_SEC / bluesync_time_source_hz();
+	int64_t start = rx_ms - (int64_t)msg->rcv.index_timeslot * CONFIG_BLUESYNC_ADV_INT_MS;
+	uint8_t nb_rounds = msg->rcv.round_id - param.scan_round_id;
+
+	k_timer_stop(&param.scan_window_timer);
+	param.scan_window_open = false;
+
+	// The radio stays on for the round
+	int64_t on_since = param.scan_on_since_ms;
+	bluesync_scan_radio_account();
+	int64_t wait = now - param.scan_wait_since_ms;
+	atomic_add(&scan_wait_ms, (atomic_val_t)wait);
+	LOG_INF("Round %u: radio on %d ms of %d ms waiting", msg->rcv.round_id,
+		(int)(on_since >= 0 ? now - on_since : 0), (int)wait);
+
+	// Same round heard again after a failed update: the prediction stands
+	if (param.scan_round_known && nb_rounds == 0) {
+		param.scan_misses = 0;
+		return;
+	}
+
+	if (param.scan_round_known && param.scan_misses < CONFIG_BLUESYNC_SCAN_MAX_MISSES) {
+		int64_t period = (start - param.scan_round_start_ms) / nb_rounds;
+
+		if (param.scan_period_ms != 0) {
+			int64_t err = period - param.scan_period_ms;
+
+			param.scan_jitter_ms = (3 * param.scan_jitter_ms + (err < 0 ? -err : err)) / 4;
+		}
+		param.scan_period_ms = period;
+	} else {
+		// First round, or after the fallback: learnt again from the next one
+		param.scan_period_ms = 0;
+		param.scan_jitter_ms = 0;
+	}
+
+	param.scan_round_known = true;
+	param.scan_round_start_ms = start;
+	param.scan_round_id = msg->rcv.round_id;
+	param.scan_misses = 0;
+}
+#endif
+
 // ADVERTISING PART ******************************************
 
-static void bluesync_adv_process() {
-	for (int i = 0; i <= SLOT_NUMBER; i++){
+/*
+ * The slots of a burst are sent from a timer instead of a sleeping loop.
+ * Slot n is due at burst start + n * CONFIG_BLUESYNC_ADV_INT_MS, computed
+ * from the start of the burst: the time taken to send a slot does not
+ * shift the next ones, and the ms to ticks rounding does not accumulate.
+ * The timer only wakes up the bluesync thread, which stays free between
+ * the slots.
+ */
+static void adv_slot_timer_handler(struct k_timer *timer){
+	bluesync_post(BLUESYNC_EVT_ADV_SLOT);
+}
+
+static void bluesync_adv_slot_timer_arm(){
+	int64_t deadline = param.adv_burst_start_ticks +
+			   (int64_t)k_ms_to_ticks_near64((uint64_t)param.adv_slot * CONFIG_BLUESYNC_ADV_INT_MS);
+
+#if defined(CONFIG_TIMEOUT_64BIT)
+	k_timer_start(&param.adv_slot_timer, K_TIMEOUT_ABS_TICKS(deadline), K_NO_WAIT);
+#else
+	k_timer_start(&param.adv_slot_timer, K_TICKS(MAX(deadline - k_uptime_ticks(), 0)), K_NO_WAIT);
+#endif
+}
+
+static void bluesync_adv_process(uint8_t round_id) {
+	k_mutex_lock(&param.mutex, K_FOREVER);
+	{
+		param.timeslot_index = 0;
+		memset(param.tx_ticks, 0, sizeof(param.tx_ticks));
+	}
+	k_mutex_unlock(&param.mutex);
+
+	param.adv_round_id = round_id;
+#if defined(CONFIG_BLUESYNC_ADV_PRELOAD)
+	param.adv_preloaded = false;
+#if defined(CONFIG_BLUESYNC_USED_IN_MESH)
+	// Once for the whole burst
+	bt_mesh_scan_disable();
+#endif
+#endif
+	param.adv_burst_running = true;
+	param.adv_slot = 0;
+	param.adv_nb_slots = SLOT_NUMBER;
+#if defined(CONFIG_BLUESYNC_AUTO_ROUNDS)
+	if (bs_state_machine_get_role() == BLUESYNC_AUTHORITY_ROLE) {
+		param.adv_nb_slots = param.auto_nb_slots;
+		param.auto_listen_pending = true;
+	}
+#endif
+	param.adv_burst_start_ticks = k_uptime_ticks();
+	bluesync_adv_slot_timer_arm();
+}
+
+/* Inter-slot TX interval error of the burst, from the adv sent timestamps */
+static void bluesync_adv_log_jitter(){
+	double nominal = (double)CONFIG_BLUESYNC_ADV_INT_MS * bluesync_time_source_hz() / 1000.0;
+	double max_err = 0.0, sum_sq = 0.0;
+	int n = 0;
+
+	k_mutex_lock(&param.mutex, K_FOREVER);
+	{
+		for (int i = 1; i < MIN(param.timeslot_index, SLOT_NUMBER); i++) {
+			double err = (double)(int64_t)(param.tx_ticks[i] - param.tx_ticks[i - 1]) -
+				     nominal;
+
+			max_err = MAX(max_err, fabs(err));
+			sum_sq += err * err;
+			n++;
+		}
+	}
+	k_mutex_unlock(&param.mutex);
+
+	if (n > 0) {
+		double us_per_tick = 1e6 / bluesync_time_source_hz();
+
+		LOG_INF("Burst sent, inter-slot jitter: max %d us, rms %d us",
+			(int)(max_err * us_per_tick), (int)(sqrt(sum_sq / n) * us_per_tick));
+	}
+}
+
+static void bluesync_adv_slot_process() {
+	// Timer expired while the burst was being aborted
+	if (!param.adv_burst_running) {
+		return;
+	}
+
+	// Slots 0 to adv_nb_slots are sent, the burst ends one interval after the last one
+	if (param.adv_slot <= param.adv_nb_slots) {
 		bluesync_send_adv();
-		k_sleep(K_MSEC(CONFIG_BLUESYNC_ADV_INT_MS));
+		param.adv_slot++;
+		bluesync_adv_slot_timer_arm();
+		return;
+	}
+
+	bluesync_adv_log_jitter();
+	param.adv_burst_running = false;
+#if defined(CONFIG_BLUESYNC_ADV_PRELOAD) && defined(CONFIG_BLUESYNC_USED_IN_MESH)
+	bt_mesh_scan_enable();
+#endif
+#if defined(CONFIG_BLUESYNC_RELAY_PIPELINE)
+	if (param.correction_pending) {
+		param.correction_pending = false;
+		apply_timer_sync(param.pending_slope, param.pending_offset);
+	}
+
+	// A relay burst may end before its round is processed, bs_adv_handler
+	// then leaves the ADV state as soon as it is entered
+	if (bs_state_machine_get_state() != BS_ADV) {
+		return;
+	}
+#endif
+	bs_state_machine_run(EVENT_ADV_EXPIRED);
+}
+
+#if defined(CONFIG_BLUESYNC_RELAY_PIPELINE)
+/* Fallback of a relay burst whose round could not be used */
+static void bluesync_adv_abort(){
+	if (!param.adv_burst_running) {
+		return;
+	}
+
+	k_timer_stop(&param.adv_slot_timer);
+	int err = bt_le_ext_adv_stop(param.adv);
+	if (err) {
+		LOG_ERR("Failed to stop extended advertising (err %d)", err);
+	}
+
+	param.adv_burst_running = false;
+	param.correction_pending = false;
+	LOG_WRN("Update failed, relay burst stopped after %u slots", param.adv_slot);
+}
+#endif
+
+#if defined(CONFIG_BLUESYNC_RELAY_SUPPRESSION)
+/*
+ * Trickle-like suppression: a client listens for a random time in
+ * [BACKOFF_MS / 2, BACKOFF_MS) after its update, and only relays if it
+ * heard fewer than CONFIG_BLUESYNC_RELAY_SUPPRESSION_K neighbours
+ * relaying the same round meanwhile.
+ */
+static void relay_backoff_timer_handler(struct k_timer *timer){
+	bluesync_post(BLUESYNC_EVT_RELAY_BACKOFF);
+}
+
+static void bluesync_relay_backoff_start(){
+	uint32_t half = CONFIG_BLUESYNC_RELAY_BACKOFF_MS / 2;
+	uint32_t delay_ms = half + sys_rand32_get() % MAX(CONFIG_BLUESYNC_RELAY_BACKOFF_MS - half, 1);
+
+	param.relay_heard = 0;
+	param.relay_backoff = true;
+	bluesync_scan_start();
+	k_timer_start(&param.relay_backoff_timer, K_MSEC(delay_ms), K_NO_WAIT);
+}
+
+static void bluesync_relay_backoff_process(){
+	if (!param.relay_backoff) {
+		return;
+	}
+
+	param.relay_backoff = false;
+	bluesync_scan_stop();
+
+	if (param.relay_heard >= CONFIG_BLUESYNC_RELAY_SUPPRESSION_K) {
+		LOG_INF("Round %u already relayed by %u neighbours, burst suppressed",
+			param.current_round_id, param.relay_heard);
+		bs_state_machine_run(EVENT_ADV_EXPIRED);
+		return;
+	}
+
+	bluesync_adv_process(param.current_round_id);
+}
+#endif
+
+#if defined(CONFIG_BLUESYNC_AUTO_ROUNDS)
+/*
+ * Authority scheduler. The rounds are started every auto_period_ms. After
+ * each burst, the authority listens for CONFIG_BLUESYNC_AUTO_LISTEN_MS to
+ * the hop 1 relays of the round, whose advertised uncertainty holds the
+ * residual RMS of their last burst and their skew error over one period
+ * (see bluesync_update_quality()). Both grow when the skew changes, e.g.
+ * after a temperature swing, the latter also with the period.
+ * Above CONFIG_BLUESYNC_AUTO_TARGET_US, the full burst is sent again and
+ * the period is halved. Below half of it, the burst is shortened by two
+ * slots down to 3/4 of SLOT_NUMBER (the update needs half of them, the
+ * rest is a margin for losses), then the period is doubled.
+ * Without any relay heard, nothing changes.
+ */
+#define BLUESYNC_AUTO_MIN_SLOTS (SLOT_NUMBER - SLOT_NUMBER / 4)
+
+static void auto_round_timer_handler(struct k_timer *timer){
+	bluesync_post(BLUESYNC_EVT_AUTO_ROUND);
+}
+
+static void auto_listen_timer_handler(struct k_timer *timer){
+	bluesync_post(BLUESYNC_EVT_AUTO_LISTEN_END);
+}
+
+static void bluesync_auto_round_process(){
+	// Previous round still running, retried shortly
+	if (bs_state_machine_get_state() != BS_STOP || param.auto_listening) {
+		k_timer_start(&param.auto_round_timer, K_MSEC(CONFIG_BLUESYNC_ADV_INT_MS), K_NO_WAIT);
+		return;
 	}
+
+	bluesync_start_net_sync();
+	k_timer_start(&param.auto_round_timer, K_MSEC(param.auto_period_ms), K_NO_WAIT);
 }
 
+static void bluesync_auto_listen_start(){
+	param.auto_listen_pending = false;
+	param.auto_listening = true;
+	param.auto_nb_heard = 0;
+	param.auto_worst_us = 0;
+	bluesync_scan_start();
+	k_timer_start(&param.auto_listen_timer, K_MSEC(CONFIG_BLUESYNC_AUTO_LISTEN_MS), K_NO_WAIT);
+}
+
+static void bluesync_auto_listen_end(){
+	if (!param.auto_listening) {
+		return;
+	}
+
+	param.auto_listening = false;
+	bluesync_scan_stop();
+
+	if (param.auto_nb_heard == 0) {
+		LOG_DBG("No relay heard, schedule unchanged");
+		return;
+	}
+
+	if (param.auto_worst_us > CONFIG_BLUESYNC_AUTO_TARGET_US) {
+		param.auto_nb_slots = SLOT_NUMBER;
+		param.auto_period_ms = MAX(param.auto_period_ms / 2, CONFIG_BLUESYNC_AUTO_PERIOD_MIN_MS);
+	} else if (param.auto_worst_us < CONFIG_BLUESYNC_AUTO_TARGET_US / 2) {
+		if (param.auto_nb_slots > BLUESYNC_AUTO_MIN_SLOTS) {
+			param.auto_nb_slots = MAX(param.auto_nb_slots - 2, BLUESYNC_AUTO_MIN_SLOTS);
+		} else {
+			param.auto_period_ms = MIN(param.auto_period_ms * 2, CONFIG_BLUESYNC_AUTO_PERIOD_MAX_MS);
+		}
+	}
+
+	LOG_INF("Worst hop 1 uncertainty %u us (%u relays): %u slots every %u ms",
+		param.auto_worst_us, param.auto_nb_heard, param.auto_nb_slots, param.auto_period_ms);
+}
+
+static void bluesync_auto_start(){
+	param.auto_period_ms = CONFIG_BLUESYNC_AUTO_PERIOD_MIN_MS;
+	param.auto_nb_slots = SLOT_NUMBER;
+	k_timer_start(&param.auto_round_timer, K_NO_WAIT, K_NO_WAIT);
+}
+#endif
+
 void adv_sent_cb(struct bt_le_ext_adv *adv, struct bt_le_ext_adv_sent_info *info)
 {
 	k_mutex_lock(&param.mutex, K_FOREVER);
 	{
 		if (info->num_sent >= 1) {
 			if( param.timeslot_index < SLOT_NUMBER){
-				param.local.timer_ticks[param.timeslot_index] = get_logical_time_ticks();
+				param.tx_ticks[param.timeslot_index] = get_logical_time_ticks();
 			}
 			param.timeslot_index++;
 		}
 	}
 	k_mutex_unlock(&param.mutex);
-#if defined(CONFIG_BLUESYNC_USED_IN_MESH)
+#if defined(CONFIG_BLUESYNC_ADV_PRELOAD)
+	// Mesh scanning is resumed at the end of the burst
+	bluesync_post(BLUESYNC_EVT_ADV_PRELOAD);
+#elif defined(CONFIG_BLUESYNC_USED_IN_MESH)
 	bt_mesh_scan_enable();
 #endif
 	
@@ -551,7 +1561,12 @@ void bs_scan_wait_for_sync_handler(void){
 	LOG_DBG("method: %s",__func__);
 	bluesync_reset_param();
 
+#if defined(CONFIG_BLUESYNC_SCHEDULED_SCAN)
+	param.scan_wait_since_ms = k_uptime_get();
+	bluesync_scan_schedule();
+#else
 	bluesync_scan_start();
+#endif
 }
 
 void bs_sync_handler(){
@@ -564,6 +1579,10 @@ void bs_update_handler(void){
 	bluesync_status_t status = end_sync_timeslot_process();
 
 	if(status != BLUESYNC_SUCCESS_STATUS){
+#if defined(CONFIG_BLUESYNC_RELAY_PIPELINE)
+		// Not relayed, as without pipelining
+		bluesync_adv_abort();
+#endif
 		bs_state_machine_run(EVENT_UPDATE_FAILED);
 		return;
 	}
@@ -574,13 +1593,47 @@ void bs_update_handler(void){
 void bs_adv_handler(void){
 	LOG_DBG("method: %s",__func__);
 
+	// The thread is no longer blocked during a burst, events received
+	// meanwhile must not restart it
+	if (param.adv_burst_running) {
+		LOG_DBG("Burst already in progress");
+		return;
+	}
+
+#if defined(CONFIG_BLUESYNC_RELAY_PIPELINE)
+	if (param.relay_pipelined) {
+		// Relay burst already sent during SYNC
+		bs_state_machine_run(EVENT_ADV_EXPIRED);
+		return;
+	}
+#endif
+
+#if defined(CONFIG_BLUESYNC_RELAY_SUPPRESSION)
+	if (param.relay_backoff) {
+		return;
+	}
+#endif
+
 	bluesync_reset_param();
-	bluesync_adv_process();
-	bs_state_machine_run(EVENT_ADV_EXPIRED);
+#if defined(CONFIG_BLUESYNC_RELAY_SUPPRESSION)
+	// The authority always sends its burst
+	if (bs_state_machine_get_role() == BLUESYNC_CLIENT_ROLE) {
+		bluesync_relay_backoff_start();
+		return;
+	}
+#endif
+	// EVENT_ADV_EXPIRED is raised once the last slot is sent
+	bluesync_adv_process(param.current_round_id);
 }
 
 void bs_stop_handler(void){
 	LOG_DBG("method: %s",__func__);
+#if defined(CONFIG_BLUESYNC_AUTO_ROUNDS)
+	// Only after a burst, not when the role is assigned
+	if (param.auto_listen_pending) {
+		bluesync_auto_listen_start();
+	}
+#endif
 }
 
 struct bs_sm_handlers handlers ={
@@ -592,71 +1645,202 @@ struct bs_sm_handlers handlers ={
 };
 
 
-// BLUESYNC THREAD *********************************
+// EXECUTION CONTEXT *******************************
 
-void bluesync_thread_fnt(void *arg1, void *arg2, void *arg3)
-{
-    // Define the event array
-    struct k_poll_event events[] = {
-		K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE,
-								 K_POLL_MODE_NOTIFY_ONLY, 
-								 &bluesync_start_new_sync_sem),
-		K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_MSGQ_DATA_AVAILABLE, 
-								 K_POLL_MODE_NOTIFY_ONLY, 
-								 &bluesync_rx_msgq),
-		K_POLL_EVENT_INITIALIZER(K_POLL_TYPE_SEM_AVAILABLE, 
-								 K_POLL_MODE_NOTIFY_ONLY, 
-								 &bluesync_end_sync_sem),
-	};
+static void bluesync_dispatch(enum bluesync_event event){
+	switch (event) {
+	case BLUESYNC_EVT_INIT:
+		bs_state_machine_run(EVENT_INIT);
+		if (bs_state_machine_get_role() == BLUESYNC_AUTHORITY_ROLE) {
+			bluesync_lock_raise(BLUESYNC_LOCK_FULL);
+		}
+#if defined(CONFIG_BLUESYNC_AUTO_ROUNDS)
+		if (bs_state_machine_get_role() == BLUESYNC_AUTHORITY_ROLE) {
+			bluesync_auto_start();
+		}
+#endif
+		break;
+	case BLUESYNC_EVT_NEW_NET_SYNC:
+		bs_state_machine_run(EVENT_NEW_NET_SYNC);
+		break;
+	case BLUESYNC_EVT_RX:
+		bluesync_scan_ring_process();
+		break;
+	case BLUESYNC_EVT_SYNC_EXPIRED:
+		bs_state_machine_run(EVENT_SYNC_EXPIRED);
+		break;
+	case BLUESYNC_EVT_ADV_SLOT:
+		bluesync_adv_slot_process();
+		break;
+	case BLUESYNC_EVT_ADV_PRELOAD:
+#if defined(CONFIG_BLUESYNC_ADV_PRELOAD)
+		bluesync_adv_preload();
+#endif
+		break;
+	case BLUESYNC_EVT_RELAY_BACKOFF:
+#if defined(CONFIG_BLUESYNC_RELAY_SUPPRESSION)
+		bluesync_relay_backoff_process();
+#endif
+		break;
+	case BLUESYNC_EVT_SCAN_WINDOW:
+#if defined(CONFIG_BLUESYNC_SCHEDULED_SCAN)
+		bluesync_scan_window_process();
+#endif
+		break;
+	case BLUESYNC_EVT_AUTO_ROUND:
+#if defined(CONFIG_BLUESYNC_AUTO_ROUNDS)
+		bluesync_auto_round_process();
+#endif
+		break;
+	case BLUESYNC_EVT_AUTO_LISTEN_END:
+#if defined(CONFIG_BLUESYNC_AUTO_ROUNDS)
+		bluesync_auto_listen_end();
+#endif
+		break;
+	default:
+		break;
+	}
+}
 
+static void bluesync_context_init(){
 	bs_state_machine_init(&handlers);
 	bluesync_init_adv();
 	k_timer_init(&param.drift_estimation_timer, drift_estimation_handler, NULL);
+	k_timer_init(&param.adv_slot_timer, adv_slot_timer_handler, NULL);
+#if defined(CONFIG_BLUESYNC_RELAY_SUPPRESSION)
+	k_timer_init(&param.relay_backoff_timer, relay_backoff_timer_handler, NULL);
+#endif
+#if defined(CONFIG_BLUESYNC_AUTO_ROUNDS)
+	k_timer_init(&param.auto_round_timer, auto_round_timer_handler, NULL);
+	k_timer_init(&param.auto_listen_timer, auto_listen_timer_handler, NULL);
+#endif
+#if defined(CONFIG_BLUESYNC_SCHEDULED_SCAN)
+	k_timer_init(&param.scan_window_timer, scan_window_timer_handler, NULL);
+	param.scan_on_since_ms = -1;
+#endif
+}
+
+#if defined(CONFIG_BLUESYNC_EXEC_THREAD)
+
+static void bluesync_post(enum bluesync_event event){
+	k_sem_give(bluesync_event_sems[event]);
+}
 
-	k_sem_take(&bluesync_role_assign_sem, K_FOREVER);
-	bs_state_machine_run(EVENT_INIT);
+void bluesync_thread_fnt(void *arg1, void *arg2, void *arg3)
+{
+    // Define the event array, in the bluesync_event order
+    struct k_poll_event events[BLUESYNC_EVT_NUM];
+
+	for (int i = 0; i < BLUESYNC_EVT_NUM; i++) {
+		k_poll_event_init(&events[i], K_POLL_TYPE_SEM_AVAILABLE,
+				  K_POLL_MODE_NOTIFY_ONLY, bluesync_event_sems[i]);
+	}
+
+	bluesync_context_init();
     
     while (1)
     {
 		k_poll(events, ARRAY_SIZE(events), K_FOREVER);
 
-		if(events[0].state == K_POLL_STATE_SEM_AVAILABLE){
-			k_sem_take(&bluesync_start_new_sync_sem, K_NO_WAIT);
-			bs_state_machine_run(EVENT_NEW_NET_SYNC);
-		}
-		
-		if(events[1].state == K_POLL_STATE_MSGQ_DATA_AVAILABLE){
-			bluesync_scan_packet_process();
+		for (int i = 0; i < BLUESYNC_EVT_NUM; i++) {
+			if (events[i].state == K_POLL_STATE_SEM_AVAILABLE) {
+				k_sem_take(bluesync_event_sems[i], K_NO_WAIT);
+				bluesync_dispatch(i);
+			}
+			// clear event
+			events[i].state = K_POLL_STATE_NOT_READY;
 		}
+    }
+}
 
-		if(events[2].state == K_POLL_STATE_SEM_AVAILABLE){
-			k_sem_take(&bluesync_end_sync_sem, K_NO_WAIT);
-			bs_state_machine_run(EVENT_SYNC_EXPIRED);
-		}
+#else
 
-		// clear events
-		events[0].state = K_POLL_STATE_NOT_READY;
-        events[1].state = K_POLL_STATE_NOT_READY;
-        events[2].state = K_POLL_STATE_NOT_READY;
-    }
+static void bluesync_post(enum bluesync_event event){
+	k_work_submit_to_queue(bluesync_work_q, &bluesync_event_works[event]);
+}
+
+/* All the items are on the same queue, they never run concurrently */
+static void bluesync_work_handler(struct k_work *work){
+	bluesync_dispatch(work - bluesync_event_works);
+}
+
+void bluesync_set_work_queue(struct k_work_q *work_q){
+	bluesync_work_q = work_q;
 }
 
+#endif
+
 // PUBLIC ******************************************
 
 void bluesync_init(){
-	LOG_DBG("bluesync init");
+	LOG_DBG("bluesync init (estimator: %s)", bluesync_estimator.name);
 
+	int err = bluesync_time_source_init();
+	if (err) {
+		LOG_ERR("Failed to initialise the time source (err %d)", err);
+		return;
+	}
+
+#if defined(CONFIG_BLUESYNC_CALIBRATION_STORE)
+	bluesync_calib_init();
+#endif
+
+#if defined(CONFIG_BLUESYNC_EXEC_THREAD)
 	k_tid_t thread_id = k_thread_create(&param.bluesync_thread, bluesync_thread_stack,
                                       K_THREAD_STACK_SIZEOF(bluesync_thread_stack),
                                       bluesync_thread_fnt, &param, NULL, NULL,
                                       CONFIG_BLUESYNC_THREAD_PRIORITY, 0, K_NO_WAIT);
 	k_thread_name_set(thread_id, "bluesync_thread");
+#else
+	if (bluesync_work_q == NULL) {
+		bluesync_work_q = &k_sys_work_q;
+	}
+	for (int i = 0; i < BLUESYNC_EVT_NUM; i++) {
+		k_work_init(&bluesync_event_works[i], bluesync_work_handler);
+	}
+	bluesync_context_init();
+#endif
+}
+
+void bluesync_get_rx_stats(struct bluesync_rx_stats *stats){
+	stats->accepted = (uint32_t)atomic_get(&rx_accepted);
+	stats->overruns = (uint32_t)atomic_get(&bluesync_rx_ring.overruns);
+	stats->malformed = (uint32_t)atomic_get(&rx_rejects[RX_REJECT_MALFORMED]);
+	stats->no_manufacturer_data = (uint32_t)atomic_get(&rx_rejects[RX_REJECT_NO_MANUFACTURER_DATA]);
+	stats->foreign_company_id = (uint32_t)atomic_get(&rx_rejects[RX_REJECT_FOREIGN_COMPANY_ID]);
+	stats->bad_length = (uint32_t)atomic_get(&rx_rejects[RX_REJECT_BAD_LENGTH]);
+	stats->duplicates = (uint32_t)atomic_get(&rx_duplicates);
+	stats->untracked = (uint32_t)atomic_get(&rx_untracked);
+}
+
+#if defined(CONFIG_BLUESYNC_SCHEDULED_SCAN)
+void bluesync_get_scan_stats(struct bluesync_scan_stats *stats){
+	stats->wait_ms = (uint32_t)atomic_get(&scan_wait_ms);
+	stats->scan_ms = (uint32_t)atomic_get(&scan_on_ms);
+	stats->missed_windows = (uint32_t)atomic_get(&scan_missed_windows);
+}
+#endif
+
+void bluesync_set_lock_cb(bluesync_lock_cb_t cb){
+	lock_cb = cb;
+}
+
+bluesync_lock_state_t bluesync_get_lock_state(void){
+	return (bluesync_lock_state_t)atomic_get(&lock_state);
 }
 
 void bluesync_set_role(bluesync_role_t role){
 	if (role != BLUESYNC_NONE_ROLE) {
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+		// The authority is the reference, clients are unknown until updated
+		bool authority = (role == BLUESYNC_AUTHORITY_ROLE);
+
+		param.hop = authority ? 0 : BLUESYNC_HOP_UNKNOWN;
+		param.uncertainty_us = authority ? 0 : BLUESYNC_UNCERTAINTY_UNKNOWN;
+#endif
+		bluesync_history_reset();
 		bs_state_machine_set_role(role);
-		k_sem_give(&bluesync_role_assign_sem);
+		bluesync_post(BLUESYNC_EVT_INIT);
 	}
 	else {
 		LOG_ERR("Wrong type given");
@@ -671,7 +1855,7 @@ void bluesync_start_net_sync(){
 			param.current_round_id++;
 		}
 		k_mutex_unlock(&param.mutex);
-		k_sem_give(&bluesync_start_new_sync_sem);
+		bluesync_post(BLUESYNC_EVT_NEW_NET_SYNC);
 	}
 }
 
@@ -679,6 +1863,7 @@ void bluesync_start_net_sync_with_unix_epoch_us(uint64_t unix_epoch_us){
 	if(bs_state_machine_get_role() == BLUESYNC_AUTHORITY_ROLE){
 		//set the new reference unix_epoch
 		set_new_epoch_unix_ref(unix_epoch_us);
+		bluesync_history_reset();
 
 		//start a new sync in the network
 		bluesync_start_net_sync();
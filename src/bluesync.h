@@ -27,6 +27,8 @@
 #include <zephyr/kernel.h>
 #include <zephyr/bluetooth/bluetooth.h>
 
+#include "bluesync_varint.h"
+
 #define SLOT_NUMBER CONFIG_BLUESYNC_SLOTS_IN_BURST
 #define NB_BYTES_BITFIELD (SLOT_NUMBER + 7) / 8
 #define BLUESYNC_TIMESTAMP_ARRAY_SIZE SLOT_NUMBER +1
@@ -55,6 +57,75 @@ typedef struct {
 #endif
 } bluesync_timestamps_t;
 
+/**
+ * @brief Sufficient statistics of one burst.
+ * 
+ * The sums are computed on the valid (local, rcv) pairs of the burst,
+ * centred on the first valid pair (origin). The sums of the deltas are
+ * exact in 64-bit integers. The products of two deltas can exceed
+ * 2^63 with high rate time sources, their sums are kept in double.
+ */
+struct bluesync_burst_stats {
+	uint32_t n;
+	uint64_t origin_x;	// local ticks of the first valid pair
+	uint64_t origin_y;	// rcv ticks of the first valid pair
+	int64_t sum_dx;
+	int64_t sum_dy;
+	double sum_dxx;
+	double sum_dxy;
+};
+
+/**
+ * @brief One (local, rcv) sample pair of a compact burst,
+ * stored as deltas from the burst origin.
+ */
+#if defined(CONFIG_BLUESYNC_HISTORY_DELTA_24BIT)
+#define BLUESYNC_HISTORY_DELTA_MAX 0xFFFFFFULL
+
+struct bluesync_history_pair {
+	uint8_t local_delta[3];
+	uint8_t rcv_delta[3];
+} __packed;
+#else
+#define BLUESYNC_HISTORY_DELTA_MAX 0xFFFFFFFFULL
+
+struct bluesync_history_pair {
+	uint32_t local_delta;
+	uint32_t rcv_delta;
+};
+#endif
+
+/**
+ * @brief Compact representation of a committed burst.
+ * 
+ * Only the pairs valid in both sets are kept, packed at the beginning
+ * of @p pairs (stats.n entries). The 64-bit bases are the origins of
+ * the statistics.
+ */
+struct bluesync_history_burst {
+	struct bluesync_burst_stats stats;
+	struct bluesync_history_pair pairs[SLOT_NUMBER];
+};
+
+#define BLUESYNC_SOURCES_MAX CONFIG_BLUESYNC_SOURCES_MAX
+
+/**
+ * @brief Burst of the current round received from one advertiser.
+ */
+struct bluesync_source {
+	bt_addr_le_t addr;
+	bluesync_timestamps_t rcv;
+	bluesync_timestamps_t local;
+	// rcv holds delta-coded timestamps
+	bool rcv_delta_coded;
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	// From the last packet of the source
+	uint32_t cost;
+	uint8_t hop;
+	uint16_t uncertainty_us;
+#endif
+};
+
 struct bluesync_param { 
 	// curent timeslot index
 	uint8_t timeslot_index;
@@ -62,24 +133,21 @@ struct bluesync_param {
 	//########### RCV ###############
 	// curent rcv burst
 	bluesync_timestamps_t rcv;
+	// rcv holds delta-coded timestamps, resolved at the end of the burst
+	bool rcv_delta_coded;
 	struct k_mutex rcv_mutex;
 
-	// Ring buffer for received bursts
-    bluesync_timestamps_t rcv_history[BURST_WINDOWS_SIZE];
-    uint8_t rcv_head;
-    uint8_t rcv_count;
-	struct k_mutex rcv_history_mutex;
-
 	//########## LOCAL ###############
 	// curent local burst
 	bluesync_timestamps_t local;
 	struct k_mutex local_mutex;
 
-	// Ring buffer for local bursts
-    bluesync_timestamps_t local_history[BURST_WINDOWS_SIZE];
-    uint8_t local_head;
-    uint8_t local_count;
-	struct k_mutex local_history_mutex;
+	//########## HISTORY #############
+	// Ring buffer of the committed bursts
+	struct bluesync_history_burst history[BURST_WINDOWS_SIZE];
+	uint8_t history_head;
+	uint8_t history_count;
+	struct k_mutex history_mutex;
 
 	//########## BLE #################
 	struct bt_le_ext_adv *adv;
@@ -88,7 +156,64 @@ struct bluesync_param {
 
 	struct k_work_delayable bluesync_adv_delayed_work;
 
+	// Burst transmission: slot n is due at adv_burst_start_ticks + n * interval
+	struct k_timer adv_slot_timer;
+	int64_t adv_burst_start_ticks;
+	uint8_t adv_slot;
+	// Slots 0 to adv_nb_slots are sent, at most SLOT_NUMBER
+	uint8_t adv_nb_slots;
+	bool adv_burst_running;
+	uint8_t adv_round_id;
+	// TX timestamps of the burst, apart from local which a relay may
+	// still be filling
+	uint64_t tx_ticks[SLOT_NUMBER];
+#if defined(CONFIG_BLUESYNC_ADV_PRELOAD)
+	// Payload of the next slot already set in the advertising set
+	bool adv_preloaded;
+#endif
+
 	struct k_timer drift_estimation_timer;
+#if defined(CONFIG_BLUESYNC_AUTO_ROUNDS)
+	// Authority scheduler: period and burst length of the next rounds
+	struct k_timer auto_round_timer;
+	uint32_t auto_period_ms;
+	uint8_t auto_nb_slots;
+	// Listening to the hop 1 relays of the last round
+	struct k_timer auto_listen_timer;
+	bool auto_listen_pending;
+	bool auto_listening;
+	uint8_t auto_nb_heard;
+	uint16_t auto_worst_us;
+#endif
+#if defined(CONFIG_BLUESYNC_SCHEDULED_SCAN)
+	// Scheduled scanning, in uptime ms: start (slot 0) and period of the
+	// rounds, 0 until two rounds were received
+	struct k_timer scan_window_timer;
+	bool scan_round_known;
+	int64_t scan_round_start_ms;
+	uint8_t scan_round_id;
+	int64_t scan_period_ms;
+	int64_t scan_jitter_ms;
+	// Window of the next predicted round
+	int64_t scan_next_ms;
+	int64_t scan_guard_ms;
+	// Error of the own estimate at the last update, for the guard
+	uint32_t scan_error_us;
+	uint32_t scan_skew_ppb;
+	bool scan_window_open;
+	uint8_t scan_misses;
+	// Radio time accounting while waiting, -1 when the radio is off
+	int64_t scan_on_since_ms;
+	int64_t scan_wait_since_ms;
+#endif
+#if defined(CONFIG_BLUESYNC_FAST_ACQUISITION)
+	// Until the first update: pairs of the best burst of the round fitted
+	// so far, and its resolved master timestamps. Guarded by rcv_mutex.
+	bool acq_done;
+	size_t acq_nb_pairs;
+	bluesync_timestamps_t acq_rcv;
+	struct bluesync_history_burst acq_burst;
+#endif
 	// Worker used to perform slave synchronisation
 	struct k_work end_sync_timeslot_worker;
 
@@ -96,8 +221,44 @@ struct bluesync_param {
 	uint8_t current_round_id;
 	uint8_t new_round_id;
 
+	// Bursts of the current round per advertiser, guarded by rcv_mutex
+	struct bluesync_source sources[BLUESYNC_SOURCES_MAX];
+	uint8_t nb_sources;
+	// Advertiser of the burst kept for the round
+	bt_addr_le_t sync_src;
+#if defined(CONFIG_BLUESYNC_RELAY_SUPPRESSION)
+	// Relay backoff, with the neighbours heard relaying the round meanwhile
+	struct k_timer relay_backoff_timer;
+	bool relay_backoff;
+	uint8_t relay_heard;
+	bt_addr_le_t relay_heard_addr[CONFIG_BLUESYNC_RELAY_SUPPRESSION_K];
+#endif
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	// Quality of the source kept for the round
+	uint8_t sync_src_hop;
+	uint16_t sync_src_uncertainty_us;
+	// Quality advertised in the bursts of this node
+	uint8_t hop;
+	uint16_t uncertainty_us;
+	// Slope of the previous update, 0 before the first one
+	double quality_slope_ticks;
+#endif
+
+#if defined(CONFIG_BLUESYNC_RELAY_PIPELINE)
+	// Updated at least once, the logical clock can be relayed
+	bool relay_synced;
+	// Relay burst of the current round started during SYNC
+	bool relay_pipelined;
+	// Correction computed while the relay burst was running
+	bool correction_pending;
+	double pending_slope;
+	double pending_offset;
+#endif
+
 	struct k_mutex mutex;
+#if defined(CONFIG_BLUESYNC_EXEC_THREAD)
 	struct k_thread bluesync_thread;
+#endif
 };
 
 /**
@@ -114,6 +275,81 @@ struct bluesync_msg {
 }__packed;
 
 
+/**
+ * @brief Number of master TX timestamps carried by each message.
+ * With 1, the original bluesync_msg format is sent.
+ */
+#define BLUESYNC_MSG_FOLLOW_UP_COUNT CONFIG_BLUESYNC_MSG_FOLLOW_UP_COUNT
+
+#define BLUESYNC_MSG_VERSION_FOLLOW_UP 2
+
+/**
+ * @brief Loss-tolerant BlueSync message (version 2).
+ *
+ * Carries the TX timestamps of the nb_ticks slots preceding
+ * index_timeslot, most recent first, so that a slot can be used even if
+ * the packet following it was lost. The original format has no version
+ * field, both are told apart by their length: a version 2 message is
+ * always longer than a bluesync_msg.
+ * The timestamps are little-endian.
+ */
+struct bluesync_msg_follow_up {
+	uint8_t version;
+	uint8_t round_id;
+	uint8_t index_timeslot;
+	uint8_t nb_ticks;
+	uint64_t master_timer_ticks[];
+}__packed;
+
+#define BLUESYNC_MSG_FOLLOW_UP_SIZE(nb_ticks) \
+	(sizeof(struct bluesync_msg_follow_up) + (nb_ticks) * sizeof(uint64_t))
+
+#define BLUESYNC_MSG_VERSION_DELTA 3
+
+/**
+ * @brief Delta-coded BlueSync message (version 3).
+ *
+ * Same content as version 2, but the nb_ticks timestamps are LEB128
+ * varints: the one of slot 0 is sent as is, the others as the
+ * difference with slot 0 of the round. The encoder never produces a
+ * message of the length of a bluesync_msg, which would be decoded as
+ * the original format: the last varint is then padded with a redundant
+ * zero group.
+ */
+struct bluesync_msg_delta {
+	uint8_t version;
+	uint8_t round_id;
+	uint8_t index_timeslot;
+	uint8_t nb_ticks;
+	uint8_t ticks[];
+}__packed;
+
+#define BLUESYNC_MSG_DELTA_MAX_SIZE(nb_ticks) \
+	(sizeof(struct bluesync_msg_delta) + (nb_ticks) * BLUESYNC_VARINT_MAX_SIZE + 1)
+
+/**
+ * @brief Set in the version field of a version 2 or 3 message followed
+ * by a bluesync_msg_quality.
+ */
+#define BLUESYNC_MSG_FLAG_QUALITY 0x80
+#define BLUESYNC_MSG_VERSION_MASK 0x7F
+
+#define BLUESYNC_HOP_UNKNOWN 0xFF
+#define BLUESYNC_UNCERTAINTY_UNKNOWN 0xFFFF
+
+/**
+ * @brief Synchronization quality of the sender, appended to a version 2
+ * or 3 message.
+ *
+ * hop is 0 for the authority and one more per relay. uncertainty_us is
+ * the error estimate accumulated along the path, little-endian. Both
+ * saturate at their unknown value.
+ */
+struct bluesync_msg_quality {
+	uint8_t hop;
+	uint16_t uncertainty_us;
+}__packed;
+
 /**
  * @brief Encapsulated BlueSync message received by the client during synchronization.
  *
@@ -123,7 +359,21 @@ struct bluesync_msg {
  */
 struct bluesync_msg_client {
 	struct bluesync_msg rcv;
+#if BLUESYNC_MSG_FOLLOW_UP_COUNT > 1
+	// TX timestamps of the slots before rcv.index_timeslot - 1, most recent first
+	uint8_t nb_follow_up;
+	uint64_t follow_up_ticks[BLUESYNC_MSG_FOLLOW_UP_COUNT - 1];
+#endif
+	// Version 3: master timestamps after slot 0 are relative to it
+	bool delta_coded;
 	uint64_t client_timer_ticks;
+	bt_addr_le_t addr;
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	// BLUESYNC_HOP_UNKNOWN and BLUESYNC_UNCERTAINTY_UNKNOWN without quality
+	uint8_t hop;
+	uint16_t uncertainty_us;
+	int8_t rssi;
+#endif
 #if defined(CONFIG_BLUESYNC_TEST_BABBLESIM_SUPPORT)
 	uint64_t master_estimation_ticks;
 #endif
@@ -0,0 +1,229 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_calib.c
+ * Description: Oscillator calibration kept across reboots
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/settings/settings.h>
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(CONFIG_BLUESYNC_CALIBRATION_TEMP)
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/sensor.h>
+#endif
+
+#include "bluesync_calib.h"
+#include "bluesync_time_source.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(bluesync_calib, CONFIG_BLUESYNC_LOG_LEVEL);
+
+#define BLUESYNC_CALIB_KEY "bluesync/calib"
+#define BLUESYNC_CALIB_TEMP_UNKNOWN INT32_MIN
+
+/* Stored record, the layout must not change without a new key */
+struct bluesync_calib_record {
+	uint32_t rate_hz;       // Time source rate of the slope
+	int32_t temp_mdeg;      // Die temperature, BLUESYNC_CALIB_TEMP_UNKNOWN if not measured
+	uint64_t master_ticks;  // Master time of the estimate
+	double slope;
+};
+
+static void calib_save_work_handler(struct k_work *work);
+
+static struct {
+	struct k_mutex mutex;
+	struct bluesync_calib_record stored;
+	bool valid;
+	// Record being written by save_work
+	struct bluesync_calib_record pending;
+	struct k_work save_work;
+	int64_t last_save_ms;
+	bool saved;
+} calib = {
+	// The settings handler may run before bluesync_calib_init()
+	.mutex = Z_MUTEX_INITIALIZER(calib.mutex),
+	.save_work = Z_WORK_INITIALIZER(calib_save_work_handler),
+};
+
+#if defined(CONFIG_BLUESYNC_CALIBRATION_TEMP)
+static const struct device *const temp_dev = DEVICE_DT_GET(DT_ALIAS(die_temp0));
+
+static int32_t calib_temp_get(void){
+	struct sensor_value val;
+
+	if (!device_is_ready(temp_dev) ||
+	    sensor_sample_fetch_chan(temp_dev, SENSOR_CHAN_DIE_TEMP) != 0 ||
+	    sensor_channel_get(temp_dev, SENSOR_CHAN_DIE_TEMP, &val) != 0) {
+		return BLUESYNC_CALIB_TEMP_UNKNOWN;
+	}
+
+	return val.val1 * 1000 + val.val2 / 1000;
+}
+#else
+static int32_t calib_temp_get(void){
+	return BLUESYNC_CALIB_TEMP_UNKNOWN;
+}
+#endif
+
+static int calib_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg){
+	const char *next;
+	struct bluesync_calib_record rec;
+
+	if (!settings_name_steq(name, "calib", &next) || next != NULL) {
+		return -ENOENT;
+	}
+	if (len != sizeof(rec)) {
+		LOG_WRN("Stored calibration of unexpected size %zu dropped", len);
+		return -EINVAL;
+	}
+
+	ssize_t rc = read_cb(cb_arg, &rec, sizeof(rec));
+	if (rc < 0) {
+		return (int)rc;
+	}
+
+	k_mutex_lock(&calib.mutex, K_FOREVER);
+	{
+		calib.stored = rec;
+		calib.valid = true;
+	}
+	k_mutex_unlock(&calib.mutex);
+	return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(bluesync_calib, "bluesync", NULL, calib_settings_set, NULL, NULL);
+
+static void calib_save_work_handler(struct k_work *work){
+	struct bluesync_calib_record rec;
+
+	k_mutex_lock(&calib.mutex, K_FOREVER);
+	{
+		rec = calib.pending;
+	}
+	k_mutex_unlock(&calib.mutex);
+
+	int err = settings_save_one(BLUESYNC_CALIB_KEY, &rec, sizeof(rec));
+	if (err) {
+		LOG_ERR("Failed to store the calibration (err %d)", err);
+		return;
+	}
+
+	k_mutex_lock(&calib.mutex, K_FOREVER);
+	{
+		calib.stored = rec;
+		calib.valid = true;
+	}
+	k_mutex_unlock(&calib.mutex);
+	LOG_INF("Calibration stored (%d ppb)", (int)lround((rec.slope - 1.0) * 1e9));
+}
+
+void bluesync_calib_init(void){
+	int err = settings_subsys_init();
+	if (!err) {
+		err = settings_load_subtree(BLUESYNC_CALIB_KEY);
+	}
+	if (err) {
+		LOG_ERR("Failed to load the calibration (err %d)", err);
+		return;
+	}
+
+	if (calib.valid) {
+		LOG_INF("Calibration restored (%d ppb)", (int)lround((calib.stored.slope - 1.0) * 1e9));
+	}
+}
+
+/* Age in seconds, negative if the record is unusable */
+static double calib_age_s(const struct bluesync_calib_record *rec, uint64_t master_ticks){
+	uint32_t rate_hz = bluesync_time_source_hz();
+
+	if (rec->rate_hz != rate_hz || master_ticks < rec->master_ticks) {
+		return -1.0;
+	}
+
+	return (double)(master_ticks - rec->master_ticks) / rate_hz;
+}
+
+double bluesync_calib_prior(uint64_t master_ticks, double *slope){
+	struct bluesync_calib_record rec;
+	bool valid;
+
+	k_mutex_lock(&calib.mutex, K_FOREVER);
+	{
+		rec = calib.stored;
+		valid = calib.valid;
+	}
+	k_mutex_unlock(&calib.mutex);
+
+	if (!valid) {
+		return 0.0;
+	}
+
+	double age_s = calib_age_s(&rec, master_ticks);
+	if (age_s < 0.0) {
+		return 0.0;
+	}
+
+#if defined(CONFIG_BLUESYNC_CALIBRATION_TEMP)
+	int32_t temp_mdeg = calib_temp_get();
+	if (temp_mdeg != BLUESYNC_CALIB_TEMP_UNKNOWN && rec.temp_mdeg != BLUESYNC_CALIB_TEMP_UNKNOWN &&
+	    abs(temp_mdeg - rec.temp_mdeg) > CONFIG_BLUESYNC_CALIBRATION_MAX_TEMP_DELTA * 1000) {
+		return 0.0;
+	}
+#endif
+
+	*slope = rec.slope;
+	return exp2(-age_s / CONFIG_BLUESYNC_CALIBRATION_HALF_LIFE_S);
+}
+
+void bluesync_calib_update(double slope, uint64_t master_ticks){
+	int64_t now_ms = k_uptime_get();
+
+	if (calib.saved && now_ms - calib.last_save_ms < CONFIG_BLUESYNC_CALIBRATION_MIN_INTERVAL_S * 1000LL) {
+		return;
+	}
+
+	k_mutex_lock(&calib.mutex, K_FOREVER);
+	{
+		// A recent record of about the same slope is kept as it is
+		double age_s = calib_age_s(&calib.stored, master_ticks);
+		bool same = calib.valid && age_s >= 0.0 &&
+			    age_s < CONFIG_BLUESYNC_CALIBRATION_MIN_INTERVAL_S &&
+			    fabs(slope - calib.stored.slope) < CONFIG_BLUESYNC_CALIBRATION_MIN_CHANGE_PPB * 1e-9;
+
+		if (same) {
+			k_mutex_unlock(&calib.mutex);
+			return;
+		}
+
+		calib.pending.rate_hz = bluesync_time_source_hz();
+		calib.pending.temp_mdeg = calib_temp_get();
+		calib.pending.master_ticks = master_ticks;
+		calib.pending.slope = slope;
+	}
+	k_mutex_unlock(&calib.mutex);
+
+	calib.saved = true;
+	calib.last_save_ms = now_ms;
+	k_work_submit(&calib.save_work);
+}
@@ -0,0 +1,70 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_calib.h
+ * Description: Oscillator calibration kept across reboots
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+
+#ifndef ZEPHYR_BLUESYNC_SRC_BLUESYNC_CALIB_H_
+#define ZEPHYR_BLUESYNC_SRC_BLUESYNC_CALIB_H_
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+/*
+ * The slope of a fully locked client is stored with the settings
+ * subsystem, with the master time of the estimate and the die
+ * temperature. After a reboot it is used as a prior: its age is known
+ * from the master timestamps of the first round received.
+ */
+
+/**
+ * @brief Load the stored calibration. Must be called after the time
+ * source is initialised.
+ */
+void bluesync_calib_init(void);
+
+/**
+ * @brief Stored slope and the trust it deserves at a given master time.
+ *
+ * The weight halves every CONFIG_BLUESYNC_CALIBRATION_HALF_LIFE_S. It is
+ * 0 without a record, if the record is from the future or from another
+ * time source rate, or if the temperature moved by more than
+ * CONFIG_BLUESYNC_CALIBRATION_MAX_TEMP_DELTA since it was stored.
+ *
+ * @param master_ticks : current master time, in ticks
+ * @param slope : stored slope, set when the weight is not 0
+ * @return double : weight of the stored slope, between 0 and 1
+ */
+double bluesync_calib_prior(uint64_t master_ticks, double *slope);
+
+/**
+ * @brief Store the slope of a fully locked update.
+ *
+ * Writes are rate limited to one per CONFIG_BLUESYNC_CALIBRATION_MIN_INTERVAL_S,
+ * and skipped while the stored slope is recent and within
+ * CONFIG_BLUESYNC_CALIBRATION_MIN_CHANGE_PPB. The flash write runs on the
+ * system work queue.
+ *
+ * @param slope : slope of the update
+ * @param master_ticks : master time of the update, in ticks
+ */
+void bluesync_calib_update(double slope, uint64_t master_ticks);
+
+#endif /* ZEPHYR_BLUESYNC_SRC_BLUESYNC_CALIB_H_ */
@@ -0,0 +1,165 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_fixed_point.h
+ * Description: Fixed-point helpers used by the clock correction
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#ifndef ZEPHYR_BLUESYNC_SRC_BLUESYNC_FIXED_POINT_H_
+#define ZEPHYR_BLUESYNC_SRC_BLUESYNC_FIXED_POINT_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Number of fractional bits of the skew (slope - 1).
+ * With 48 bits, the quantisation error stays below 2^-9 ticks
+ * after 2^40 ticks of uptime (~1 year at 32768 Hz), and below half a tick
+ * after 2^48 ticks (~50 days at 64 MHz).
+ */
+#define BS_FP_SKEW_FRAC_BITS 48
+
+/**
+ * @brief Number of fractional bits of the offset fraction.
+ */
+#define BS_FP_OFFSET_FRAC_BITS 32
+
+/**
+ * @brief Unsigned 64x64 -> 128 bits multiplication.
+ * 
+ * @param a 
+ * @param b 
+ * @param hi : upper 64 bits of the product
+ * @param lo : lower 64 bits of the product
+ */
+static inline void bs_fp_umul64(uint64_t a, uint64_t b, uint64_t *hi, uint64_t *lo)
+{
+#if defined(__SIZEOF_INT128__)
+	unsigned __int128 p = (unsigned __int128)a * b;
+
+	*hi = (uint64_t)(p >> 64);
+	*lo = (uint64_t)p;
+#else
+	// 32-bit targets: build the product from four 32x32 -> 64 partial products
+	uint64_t a_lo = (uint32_t)a, a_hi = a >> 32;
+	uint64_t b_lo = (uint32_t)b, b_hi = b >> 32;
+
+	uint64_t p0 = a_lo * b_lo;
+	uint64_t p1 = a_lo * b_hi;
+	uint64_t p2 = a_hi * b_lo;
+	uint64_t p3 = a_hi * b_hi;
+
+	uint64_t mid = (p0 >> 32) + (uint32_t)p1 + (uint32_t)p2;
+
+	*lo = (mid << 32) | (uint32_t)p0;
+	*hi = p3 + (p1 >> 32) + (p2 >> 32) + (mid >> 32);
+#endif
+}
+
+/**
+ * @brief Signed multiply-shift: (a * b) >> shift, computed on 128 bits.
+ * The result is truncated toward zero and must fit in 64 bits.
+ * 
+ * @param a 
+ * @param b 
+ * @param shift : between 1 and 63
+ * @return int64_t 
+ */
+static inline int64_t bs_fp_mul_shift(int64_t a, int64_t b, unsigned int shift)
+{
+	bool neg = (a < 0) != (b < 0);
+	uint64_t ua = (a < 0) ? -(uint64_t)a : (uint64_t)a;
+	uint64_t ub = (b < 0) ? -(uint64_t)b : (uint64_t)b;
+	uint64_t hi, lo;
+
+	bs_fp_umul64(ua, ub, &hi, &lo);
+
+	uint64_t r = (lo >> shift) | (hi << (64 - shift));
+
+	return neg ? -(int64_t)r : (int64_t)r;
+}
+
+/**
+ * @brief Multiply a value by a Q48 factor, computed on 128 bits.
+ * The product is split into an integer part and a Q32 fraction, both
+ * truncated toward zero, so that large products (high rate time sources,
+ * long uptimes) do not overflow the Q32 representation.
+ * 
+ * @param a 
+ * @param b_q48 
+ * @param frac_q32 : fractional part of the product, same sign as the product
+ * @return int64_t : integer part of the product
+ */
+static inline int64_t bs_fp_mul_q48(int64_t a, int64_t b_q48, int64_t *frac_q32)
+{
+	bool neg = (a < 0) != (b_q48 < 0);
+	uint64_t ua = (a < 0) ? -(uint64_t)a : (uint64_t)a;
+	uint64_t ub = (b_q48 < 0) ? -(uint64_t)b_q48 : (uint64_t)b_q48;
+	uint64_t hi, lo;
+
+	bs_fp_umul64(ua, ub, &hi, &lo);
+
+	uint64_t integer = (lo >> BS_FP_SKEW_FRAC_BITS) | (hi << (64 - BS_FP_SKEW_FRAC_BITS));
+	uint64_t frac = (lo >> (BS_FP_SKEW_FRAC_BITS - BS_FP_OFFSET_FRAC_BITS)) &
+			((UINT64_C(1) << BS_FP_OFFSET_FRAC_BITS) - 1);
+
+	*frac_q32 = neg ? -(int64_t)frac : (int64_t)frac;
+	return neg ? -(int64_t)integer : (int64_t)integer;
+}
+
+/**
+ * @brief Round a Q32 value to the nearest integer.
+ * 
+ * @param value_q32 
+ * @return int64_t 
+ */
+static inline int64_t bs_fp_round_q32(int64_t value_q32)
+{
+	return (value_q32 + (INT64_C(1) << (BS_FP_OFFSET_FRAC_BITS - 1))) >> BS_FP_OFFSET_FRAC_BITS;
+}
+
+/**
+ * @brief Convert a ticks value into us without any floating point.
+ * The result is truncated toward zero, like the double implementation.
+ * 
+ * @param ticks 
+ * @param rate_hz : tick rate of @p ticks
+ * @return int64_t 
+ */
+static inline int64_t bs_fp_ticks_to_us(int64_t ticks, uint64_t rate_hz)
+{
+	uint64_t mag = (ticks < 0) ? -(uint64_t)ticks : (uint64_t)ticks;
+	uint64_t us = (mag / rate_hz) * 1000000ULL + ((mag % rate_hz) * 1000000ULL) / rate_hz;
+
+	return (ticks < 0) ? -(int64_t)us : (int64_t)us;
+}
+
+/**
+ * @brief Convert a us value into ticks without any floating point.
+ * The result is rounded to the nearest tick.
+ * 
+ * @param us 
+ * @param rate_hz : tick rate of the result
+ * @return uint64_t 
+ */
+static inline uint64_t bs_fp_us_to_ticks(uint64_t us, uint64_t rate_hz)
+{
+	return (us / 1000000ULL) * rate_hz + ((us % 1000000ULL) * rate_hz + 500000ULL) / 1000000ULL;
+}
+
+#endif /* ZEPHYR_BLUESYNC_SRC_BLUESYNC_FIXED_POINT_H_ */
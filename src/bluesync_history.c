@@ -0,0 +1,127 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_history.c
+ * Description: Compact delta-encoded storage of the committed bursts
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <math.h>
+
+#include "bluesync_history.h"
+#include "bluesync_bitfields.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(bluesync_history, CONFIG_BLUESYNC_LOG_LEVEL);
+
+static void history_pair_set(struct bluesync_history_pair *pair, uint32_t dx, uint32_t dy)
+{
+#if defined(CONFIG_BLUESYNC_HISTORY_DELTA_24BIT)
+	sys_put_le24(dx, pair->local_delta);
+	sys_put_le24(dy, pair->rcv_delta);
+#else
+	pair->local_delta = dx;
+	pair->rcv_delta = dy;
+#endif
+}
+
+static void history_pair_get(const struct bluesync_history_pair *pair, uint32_t *dx, uint32_t *dy)
+{
+#if defined(CONFIG_BLUESYNC_HISTORY_DELTA_24BIT)
+	*dx = sys_get_le24(pair->local_delta);
+	*dy = sys_get_le24(pair->rcv_delta);
+#else
+	*dx = pair->local_delta;
+	*dy = pair->rcv_delta;
+#endif
+}
+
+void bluesync_history_store(struct bluesync_history_burst *dst,
+			    const bluesync_timestamps_t *rcv,
+			    const bluesync_timestamps_t *local)
+{
+	struct bluesync_burst_stats *stats = &dst->stats;
+
+	uint8_t burst_bitfield[NB_BYTES_BITFIELD] = {0};
+	bitwise_and_bitfields(burst_bitfield, rcv, local, NB_BYTES_BITFIELD);
+
+	memset(stats, 0, sizeof(*stats));
+
+	for (int i = 0; i < SLOT_NUMBER; i++) {
+		if (!is_bit_set(burst_bitfield, i)) {
+			continue;
+		}
+
+		if (stats->n == 0) {
+			stats->origin_x = local->timer_ticks[i];
+			stats->origin_y = rcv->timer_ticks[i];
+		}
+
+		// Timestamps of a burst are increasing, deltas are positive
+		uint64_t dx = local->timer_ticks[i] - stats->origin_x;
+		uint64_t dy = rcv->timer_ticks[i] - stats->origin_y;
+
+		if (dx > BLUESYNC_HISTORY_DELTA_MAX || dy > BLUESYNC_HISTORY_DELTA_MAX) {
+			LOG_WRN("Slot %d dropped: delta out of range", i);
+			continue;
+		}
+
+		history_pair_set(&dst->pairs[stats->n], (uint32_t)dx, (uint32_t)dy);
+
+		stats->sum_dx += (int64_t)dx;
+		stats->sum_dy += (int64_t)dy;
+		stats->sum_dxx += (double)dx * (double)dx;
+		stats->sum_dxy += (double)dx * (double)dy;
+		stats->n++;
+	}
+}
+
+void bluesync_history_get_pair(const struct bluesync_history_burst *burst, size_t idx,
+			       uint64_t *local_ticks, uint64_t *rcv_ticks)
+{
+	uint32_t dx, dy;
+
+	history_pair_get(&burst->pairs[idx], &dx, &dy);
+
+	*local_ticks = burst->stats.origin_x + dx;
+	*rcv_ticks = burst->stats.origin_y + dy;
+}
+
+double bluesync_history_residual_rms(const struct bluesync_history_burst *burst,
+				     double slope, double offset)
+{
+	if (burst->stats.n == 0) {
+		return 0.0;
+	}
+
+	// Residual at the origin, the pairs only add small deltas to it
+	double base = (double)burst->stats.origin_y - slope * (double)burst->stats.origin_x - offset;
+	double sum_sq = 0.0;
+
+	for (size_t i = 0; i < burst->stats.n; i++) {
+		uint32_t dx, dy;
+
+		history_pair_get(&burst->pairs[i], &dx, &dy);
+
+		double r = base + (double)dy - slope * (double)dx;
+		sum_sq += r * r;
+	}
+
+	return sqrt(sum_sq / burst->stats.n);
+}
@@ -0,0 +1,67 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_history.h
+ * Description: Compact delta-encoded storage of the committed bursts
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+
+#ifndef ZEPHYR_BLUESYNC_SRC_BLUESYNC_HISTORY_H_
+#define ZEPHYR_BLUESYNC_SRC_BLUESYNC_HISTORY_H_
+
+#include "bluesync.h"
+
+/**
+ * @brief Encode a burst into its compact history representation.
+ * 
+ * Only the slots valid in both sets are kept. Their timestamps are
+ * stored as deltas from the first valid pair, and the sufficient
+ * statistics of the burst are computed in the same pass.
+ * A slot whose delta does not fit in BLUESYNC_HISTORY_DELTA_MAX is dropped.
+ * 
+ * @param dst : compact burst to fill
+ * @param rcv : timestamps received from the master
+ * @param local : local timestamps of the same burst
+ */
+void bluesync_history_store(struct bluesync_history_burst *dst,
+			    const bluesync_timestamps_t *rcv,
+			    const bluesync_timestamps_t *local);
+
+/**
+ * @brief Get a decoded sample pair from a compact burst.
+ * 
+ * @param burst : compact burst
+ * @param idx : index of the pair, lower than burst->stats.n
+ * @param local_ticks : output local timestamp
+ * @param rcv_ticks : output master timestamp
+ */
+void bluesync_history_get_pair(const struct bluesync_history_burst *burst, size_t idx,
+			       uint64_t *local_ticks, uint64_t *rcv_ticks);
+
+/**
+ * @brief RMS of the residuals of a compact burst against a correction.
+ * 
+ * @param burst : compact burst
+ * @param slope : slope of the correction, master = slope * local + offset
+ * @param offset : offset of the correction
+ * @return double : RMS in ticks, 0 if the burst holds no pair
+ */
+double bluesync_history_residual_rms(const struct bluesync_history_burst *burst,
+				     double slope, double offset);
+
+#endif /* ZEPHYR_BLUESYNC_SRC_BLUESYNC_HISTORY_H_ */
@@ -0,0 +1,232 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_msg.c
+ * Description: Encoding and decoding of the burst packets
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+#include <string.h>
+
+#include "bluesync_msg.h"
+#include "bluesync_bitfields.h"
+#include "bluesync_varint.h"
+
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+static size_t bluesync_msg_encode_quality(uint8_t *dst, uint8_t hop, uint16_t uncertainty_us){
+	dst[offsetof(struct bluesync_msg_quality, hop)] = hop;
+	sys_put_le16(uncertainty_us, &dst[offsetof(struct bluesync_msg_quality, uncertainty_us)]);
+	return sizeof(struct bluesync_msg_quality);
+}
+#endif
+
+size_t bluesync_msg_encode(uint8_t *dst, uint8_t round_id, uint8_t slot, const uint64_t *tx_ticks,
+			   uint8_t hop, uint16_t uncertainty_us){
+	size_t len;
+
+	memset(dst, 0, BLUESYNC_MSG_MAX_SIZE);
+
+#if defined(CONFIG_BLUESYNC_MSG_DELTA_ENCODING)
+	struct bluesync_msg_delta *msg = (struct bluesync_msg_delta *)dst;
+	uint8_t nb_ticks = MIN(slot, BLUESYNC_MSG_FOLLOW_UP_COUNT);
+
+	msg->version = BLUESYNC_MSG_VERSION_DELTA;
+	msg->round_id = round_id;
+	msg->index_timeslot = slot;
+	msg->nb_ticks = nb_ticks;
+
+	// Slot 0 as is, the next ones relative to it (a few bytes each)
+	len = offsetof(struct bluesync_msg_delta, ticks);
+	for (int i = 0; i < nb_ticks; i++) {
+		int prev = slot - 1 - i;
+		uint64_t value = prev == 0 ? tx_ticks[0] : tx_ticks[prev] - tx_ticks[0];
+
+		len += bluesync_varint_put(value, &dst[len]);
+	}
+
+	// Would be decoded as the original format: pad the last varint
+	if (len + BLUESYNC_MSG_QUALITY_LEN == sizeof(struct bluesync_msg)) {
+		dst[len - 1] |= 0x80;
+		dst[len] = 0x00;
+		len++;
+	}
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	msg->version |= BLUESYNC_MSG_FLAG_QUALITY;
+	len += bluesync_msg_encode_quality(&dst[len], hop, uncertainty_us);
+#endif
+#elif BLUESYNC_MSG_FOLLOW_UP_COUNT > 1 || defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	struct bluesync_msg_follow_up *msg = (struct bluesync_msg_follow_up *)dst;
+
+	msg->version = BLUESYNC_MSG_VERSION_FOLLOW_UP;
+	msg->round_id = round_id;
+	msg->index_timeslot = slot;
+	msg->nb_ticks = BLUESYNC_MSG_FOLLOW_UP_COUNT;
+
+	// Slots before the first one of the round are sent as 0
+	for (int i = 0; i < BLUESYNC_MSG_FOLLOW_UP_COUNT; i++) {
+		int prev = slot - 1 - i;
+
+		sys_put_le64(prev >= 0 ? tx_ticks[prev] : 0,
+			     (uint8_t *)&msg->master_timer_ticks[i]);
+	}
+	len = BLUESYNC_MSG_FOLLOW_UP_SIZE(BLUESYNC_MSG_FOLLOW_UP_COUNT);
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	msg->version |= BLUESYNC_MSG_FLAG_QUALITY;
+	len += bluesync_msg_encode_quality(&dst[len], hop, uncertainty_us);
+#endif
+#else
+	struct bluesync_msg msg = {
+		.round_id = round_id,
+		.index_timeslot = slot,
+		.master_timer_ticks = slot == 0 ? 0 : tx_ticks[slot - 1]
+	};
+
+	memcpy(dst, &msg, sizeof(struct bluesync_msg));
+	len = sizeof(struct bluesync_msg);
+#endif
+
+	return len;
+}
+
+/* Version 3: exactly nb_ticks varints */
+static bool bluesync_msg_delta_valid(const uint8_t *payload, size_t len){
+	uint8_t nb_ticks = payload[offsetof(struct bluesync_msg_delta, nb_ticks)];
+	size_t pos = offsetof(struct bluesync_msg_delta, ticks);
+	uint64_t value;
+
+	for (int i = 0; i < nb_ticks; i++) {
+		size_t n = bluesync_varint_get(&payload[pos], len - pos, &value);
+
+		if (n == 0) {
+			return false;
+		}
+		pos += n;
+	}
+
+	return pos == len;
+}
+
+bool bluesync_msg_valid(const uint8_t *payload, size_t len){
+	if (len == sizeof(struct bluesync_msg)) {
+		return true;
+	}
+
+	if (len < sizeof(struct bluesync_msg_delta)) {
+		return false;
+	}
+
+	uint8_t version = payload[offsetof(struct bluesync_msg_delta, version)];
+
+	if (version & BLUESYNC_MSG_FLAG_QUALITY) {
+		if (len < sizeof(struct bluesync_msg_delta) + sizeof(struct bluesync_msg_quality)) {
+			return false;
+		}
+		len -= sizeof(struct bluesync_msg_quality);
+		version &= BLUESYNC_MSG_VERSION_MASK;
+	}
+
+	if (version == BLUESYNC_MSG_VERSION_DELTA) {
+		return bluesync_msg_delta_valid(payload, len);
+	}
+
+	return len >= BLUESYNC_MSG_FOLLOW_UP_SIZE(1) &&
+	       version == BLUESYNC_MSG_VERSION_FOLLOW_UP &&
+	       len == BLUESYNC_MSG_FOLLOW_UP_SIZE(payload[offsetof(struct bluesync_msg_follow_up, nb_ticks)]);
+}
+
+void bluesync_msg_decode(struct bluesync_msg_client *msg, const uint8_t *payload, size_t len,
+			 int64_t rx_ticks){
+	msg->client_timer_ticks = rx_ticks;
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	msg->hop = BLUESYNC_HOP_UNKNOWN;
+	msg->uncertainty_us = BLUESYNC_UNCERTAINTY_UNKNOWN;
+#endif
+
+	// The original format is told apart by its total length
+	bool original = (len == sizeof(struct bluesync_msg));
+
+	if (!original && (payload[0] & BLUESYNC_MSG_FLAG_QUALITY)) {
+		// Already validated by bluesync_msg_valid()
+		len -= sizeof(struct bluesync_msg_quality);
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+		msg->hop = payload[len + offsetof(struct bluesync_msg_quality, hop)];
+		msg->uncertainty_us = sys_get_le16(&payload[len + offsetof(struct bluesync_msg_quality, uncertainty_us)]);
+#endif
+	}
+
+	if (original) {
+		msg->rcv.round_id = payload[offsetof(struct bluesync_msg, round_id)];
+		msg->rcv.index_timeslot = payload[offsetof(struct bluesync_msg, index_timeslot)];
+		msg->rcv.master_timer_ticks = sys_get_le64(&payload[offsetof(struct bluesync_msg, master_timer_ticks)]);
+#if BLUESYNC_MSG_FOLLOW_UP_COUNT > 1
+		msg->nb_follow_up = 0;
+#endif
+		msg->delta_coded = false;
+	} else if ((payload[offsetof(struct bluesync_msg_delta, version)] & BLUESYNC_MSG_VERSION_MASK) ==
+		   BLUESYNC_MSG_VERSION_DELTA) {
+		// Already validated by bluesync_msg_valid()
+		uint8_t nb_ticks = payload[offsetof(struct bluesync_msg_delta, nb_ticks)];
+		size_t pos = offsetof(struct bluesync_msg_delta, ticks);
+
+		msg->rcv.round_id = payload[offsetof(struct bluesync_msg_delta, round_id)];
+		msg->rcv.index_timeslot = payload[offsetof(struct bluesync_msg_delta, index_timeslot)];
+		uint64_t ticks = 0;
+
+		if (nb_ticks > 0) {
+			pos += bluesync_varint_get(&payload[pos], len - pos, &ticks);
+		}
+		msg->rcv.master_timer_ticks = ticks;
+		msg->delta_coded = true;
+#if BLUESYNC_MSG_FOLLOW_UP_COUNT > 1
+		msg->nb_follow_up = MIN(MAX(nb_ticks, 1) - 1, BLUESYNC_MSG_FOLLOW_UP_COUNT - 1);
+		for (int i = 0; i < msg->nb_follow_up; i++) {
+			pos += bluesync_varint_get(&payload[pos], len - pos, &msg->follow_up_ticks[i]);
+		}
+#endif
+	} else {
+		const uint8_t *ticks = &payload[offsetof(struct bluesync_msg_follow_up, master_timer_ticks)];
+
+		msg->rcv.round_id = payload[offsetof(struct bluesync_msg_follow_up, round_id)];
+		msg->rcv.index_timeslot = payload[offsetof(struct bluesync_msg_follow_up, index_timeslot)];
+		msg->rcv.master_timer_ticks = sys_get_le64(ticks);
+#if BLUESYNC_MSG_FOLLOW_UP_COUNT > 1
+		// Follow-ups beyond our own count are ignored
+		uint8_t nb_ticks = payload[offsetof(struct bluesync_msg_follow_up, nb_ticks)];
+
+		msg->nb_follow_up = MIN(nb_ticks - 1, BLUESYNC_MSG_FOLLOW_UP_COUNT - 1);
+		for (int i = 0; i < msg->nb_follow_up; i++) {
+			msg->follow_up_ticks[i] = sys_get_le64(&ticks[(i + 1) * sizeof(uint64_t)]);
+		}
+#endif
+		msg->delta_coded = false;
+	}
+}
+
+bool bluesync_msg_resolve_deltas(bluesync_timestamps_t *rcv){
+	if (!is_bit_set(rcv->bitfield, 0)) {
+		memset(rcv->bitfield, 0, sizeof(rcv->bitfield));
+		return false;
+	}
+
+	for (size_t i = 1; i < SLOT_NUMBER; i++) {
+		rcv->timer_ticks[i] += rcv->timer_ticks[0];
+	}
+	return true;
+}
@@ -0,0 +1,106 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_msg.h
+ * Description: Encoding and decoding of the burst packets
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+
+#ifndef ZEPHYR_BLUESYNC_SRC_BLUESYNC_MSG_H_
+#define ZEPHYR_BLUESYNC_SRC_BLUESYNC_MSG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "bluesync.h"
+
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+#define BLUESYNC_MSG_QUALITY_LEN sizeof(struct bluesync_msg_quality)
+#else
+#define BLUESYNC_MSG_QUALITY_LEN 0
+#endif
+
+/**
+ * @brief Largest payload sent by this node, company ID excluded.
+ */
+#if defined(CONFIG_BLUESYNC_MSG_DELTA_ENCODING)
+#define BLUESYNC_MSG_MAX_SIZE \
+	(BLUESYNC_MSG_DELTA_MAX_SIZE(BLUESYNC_MSG_FOLLOW_UP_COUNT) + BLUESYNC_MSG_QUALITY_LEN)
+#elif BLUESYNC_MSG_FOLLOW_UP_COUNT > 1 || defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+#define BLUESYNC_MSG_MAX_SIZE \
+	(BLUESYNC_MSG_FOLLOW_UP_SIZE(BLUESYNC_MSG_FOLLOW_UP_COUNT) + BLUESYNC_MSG_QUALITY_LEN)
+#else
+#define BLUESYNC_MSG_MAX_SIZE sizeof(struct bluesync_msg)
+#endif
+
+/**
+ * @brief Encode the payload of a burst slot in the configured format.
+ *
+ * tx_ticks holds the TX timestamps of the slots already sent in this
+ * round. The message carries the one of the previous slot, and with the
+ * version 2 and 3 formats the ones before it.
+ *
+ * @param dst : at least BLUESYNC_MSG_MAX_SIZE bytes
+ * @param round_id
+ * @param slot : index of the slot in the burst
+ * @param tx_ticks : TX timestamps of the slots 0 to slot - 1
+ * @param hop : hop count of this node, ignored without
+ * CONFIG_BLUESYNC_SOURCE_SELECTION
+ * @param uncertainty_us : uncertainty of this node, ignored without
+ * CONFIG_BLUESYNC_SOURCE_SELECTION
+ * @return size_t : length of the payload
+ */
+size_t bluesync_msg_encode(uint8_t *dst, uint8_t round_id, uint8_t slot, const uint64_t *tx_ticks,
+			   uint8_t hop, uint16_t uncertainty_us);
+
+/**
+ * @brief Check a received payload: original format, or version 2/3 whose
+ * length matches its nb_ticks, plus the quality trailer when flagged.
+ *
+ * @param payload : payload after the company ID
+ * @param len
+ * @return true if it can be given to bluesync_msg_decode()
+ */
+bool bluesync_msg_valid(const uint8_t *payload, size_t len);
+
+/**
+ * @brief Decode a payload accepted by bluesync_msg_valid().
+ *
+ * The address and the RSSI of @p msg are left to the caller.
+ *
+ * @param msg : decoded message
+ * @param payload : payload after the company ID
+ * @param len
+ * @param rx_ticks : local reception timestamp
+ */
+void bluesync_msg_decode(struct bluesync_msg_client *msg, const uint8_t *payload, size_t len,
+			 int64_t rx_ticks);
+
+/**
+ * @brief Resolve the master timestamps of a version 3 round.
+ *
+ * The timestamps after slot 0 are relative to it. Without slot 0 they
+ * cannot be used: the bitfield is then cleared.
+ *
+ * @param rcv : master timestamps of the round
+ * @return false if slot 0 was lost
+ */
+bool bluesync_msg_resolve_deltas(bluesync_timestamps_t *rcv);
+
+#endif /* ZEPHYR_BLUESYNC_SRC_BLUESYNC_MSG_H_ */
@@ -0,0 +1,111 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_regression.c
+ * Description: Sliding-window linear regression based on per-burst statistics
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#include <zephyr/kernel.h>
+#include <math.h>
+
+#include "bluesync_regression.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(bluesync_regression, CONFIG_BLUESYNC_LOG_LEVEL);
+
+bluesync_status_t bluesync_regression_from_stats(const struct bluesync_history_burst *bursts,
+						 size_t count,
+						 double *slope,
+						 double *offset,
+						 size_t min_nb_timestamp)
+{
+	size_t n = 0;
+	const struct bluesync_burst_stats *ref = NULL;
+
+	// First pass: total count and means relative to a reference origin
+	double mean_x = 0.0, mean_y = 0.0;
+
+	for (size_t b = 0; b < count; b++) {
+		const struct bluesync_burst_stats *s = &bursts[b].stats;
+
+		if (s->n == 0) {
+			continue;
+		}
+		if (ref == NULL) {
+			ref = s;
+		}
+
+		double ox = (double)(int64_t)(s->origin_x - ref->origin_x);
+		double oy = (double)(int64_t)(s->origin_y - ref->origin_y);
+
+		mean_x += (double)s->sum_dx + s->n * ox;
+		mean_y += (double)s->sum_dy + s->n * oy;
+		n += s->n;
+	}
+
+	if (n == 0) {
+		LOG_ERR("No valid data in history for regression.");
+		return BLUESYNC_NO_VALID_DATA_STATUS;
+	} else if (n < min_nb_timestamp) {
+		LOG_ERR("Not enough valid samples in history (min = %zu, got = %zu)", min_nb_timestamp, n);
+		return BLUESYNC_NO_ENOUGH_DATA_STATUS;
+	}
+
+	mean_x /= n;
+	mean_y /= n;
+
+	// Second pass: pooled covariance and variance.
+	// Each burst contributes its own centred sums plus the
+	// spread of its mean around the global mean.
+	double sum_cov = 0.0;
+	double sum_var = 0.0;
+
+	for (size_t b = 0; b < count; b++) {
+		const struct bluesync_burst_stats *s = &bursts[b].stats;
+
+		if (s->n == 0) {
+			continue;
+		}
+
+		double burst_mean_dx = (double)s->sum_dx / s->n;
+		double burst_mean_dy = (double)s->sum_dy / s->n;
+
+		double cxx = s->sum_dxx - (double)s->sum_dx * burst_mean_dx;
+		double cxy = s->sum_dxy - (double)s->sum_dx * burst_mean_dy;
+
+		double mx = (double)(int64_t)(s->origin_x - ref->origin_x) + burst_mean_dx - mean_x;
+		double my = (double)(int64_t)(s->origin_y - ref->origin_y) + burst_mean_dy - mean_y;
+
+		sum_var += cxx + s->n * mx * mx;
+		sum_cov += cxy + s->n * mx * my;
+	}
+
+	if (fabs(sum_var) < 1e-12) {
+		LOG_ERR("Variance too small → numerical instability (%e)", sum_var);
+		return BLUESYNC_DENOMINATOR_TOO_SMALL;
+	}
+
+	*slope = sum_cov / sum_var;
+
+	double abs_mean_x = (double)ref->origin_x + mean_x;
+	double abs_mean_y = (double)ref->origin_y + mean_y;
+
+	*offset = abs_mean_y - (*slope * abs_mean_x);
+
+	return BLUESYNC_SUCCESS_STATUS;
+}
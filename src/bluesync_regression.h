@@ -0,0 +1,47 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_regression.h
+ * Description: Sliding-window linear regression based on per-burst statistics
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+
+#ifndef ZEPHYR_BLUESYNC_SRC_BLUESYNC_REGRESSION_H_
+#define ZEPHYR_BLUESYNC_SRC_BLUESYNC_REGRESSION_H_
+
+#include "bluesync.h"
+
+/**
+ * @brief Compute the least-squares slope and offset of a window of bursts.
+ * Only the statistics of the bursts are used: the cost is O(count),
+ * independent of the number of slots per burst.
+ * 
+ * @param bursts : array of committed bursts
+ * @param count : number of bursts in @p bursts
+ * @param slope : output slope
+ * @param offset : output offset
+ * @param min_nb_timestamp : minimal number of valid pairs required
+ * @return bluesync_status_t 
+ */
+bluesync_status_t bluesync_regression_from_stats(const struct bluesync_history_burst *bursts,
+						 size_t count,
+						 double *slope,
+						 double *offset,
+						 size_t min_nb_timestamp);
+
+#endif /* ZEPHYR_BLUESYNC_SRC_BLUESYNC_REGRESSION_H_ */
@@ -0,0 +1,123 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_rx_ring.h
+ * Description: Lock-free single-producer/single-consumer ring of received messages
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+
+#ifndef ZEPHYR_BLUESYNC_SRC_BLUESYNC_RX_RING_H_
+#define ZEPHYR_BLUESYNC_SRC_BLUESYNC_RX_RING_H_
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/barrier.h>
+
+#include "bluesync.h"
+
+/*
+ * The scan callback (BT RX context) is the only producer, the bluesync
+ * thread the only consumer. Each side only writes its own index, so no
+ * lock is needed: the producer decodes directly into the free entry and
+ * publishes it by moving head, the consumer processes the entry in place
+ * and releases it by moving tail. One entry is kept free to tell a full
+ * ring from an empty one.
+ *
+ * A full burst (SLOT_NUMBER + 1 messages) fits without being consumed.
+ */
+#define BLUESYNC_RX_RING_SIZE (BLUESYNC_TIMESTAMP_ARRAY_SIZE + 1)
+
+struct bluesync_rx_ring {
+	atomic_t head; // written by the producer only
+	atomic_t tail; // written by the consumer only
+	atomic_t overruns;
+	struct bluesync_msg_client msgs[BLUESYNC_RX_RING_SIZE];
+};
+
+#define BLUESYNC_RX_RING_INITIALIZER { \
+	.head = ATOMIC_INIT(0), \
+	.tail = ATOMIC_INIT(0), \
+	.overruns = ATOMIC_INIT(0), \
+}
+
+/**
+ * @brief Get the free entry to write, producer side.
+ * 
+ * @param ring 
+ * @return struct bluesync_msg_client* : NULL if the ring is full, the
+ * overrun counter is then incremented
+ */
+static inline struct bluesync_msg_client *bluesync_rx_ring_reserve(struct bluesync_rx_ring *ring)
+{
+	atomic_val_t head = atomic_get(&ring->head);
+
+	if ((head + 1) % BLUESYNC_RX_RING_SIZE == atomic_get(&ring->tail)) {
+		atomic_inc(&ring->overruns);
+		return NULL;
+	}
+
+	return &ring->msgs[head];
+}
+
+/**
+ * @brief Publish the entry returned by bluesync_rx_ring_reserve().
+ * 
+ * @param ring 
+ */
+static inline void bluesync_rx_ring_commit(struct bluesync_rx_ring *ring)
+{
+	atomic_val_t head = atomic_get(&ring->head);
+
+	// The entry must be visible before the new head
+	barrier_dmem_fence_full();
+	atomic_set(&ring->head, (head + 1) % BLUESYNC_RX_RING_SIZE);
+}
+
+/**
+ * @brief Get the oldest published entry, consumer side.
+ * 
+ * @param ring 
+ * @return struct bluesync_msg_client* : NULL if the ring is empty
+ */
+static inline struct bluesync_msg_client *bluesync_rx_ring_peek(struct bluesync_rx_ring *ring)
+{
+	atomic_val_t tail = atomic_get(&ring->tail);
+
+	if (tail == atomic_get(&ring->head)) {
+		return NULL;
+	}
+
+	barrier_dmem_fence_full();
+	return &ring->msgs[tail];
+}
+
+/**
+ * @brief Release the entry returned by bluesync_rx_ring_peek().
+ * 
+ * @param ring 
+ */
+static inline void bluesync_rx_ring_release(struct bluesync_rx_ring *ring)
+{
+	atomic_val_t tail = atomic_get(&ring->tail);
+
+	// The entry must be fully read before the producer can reuse it
+	barrier_dmem_fence_full();
+	atomic_set(&ring->tail, (tail + 1) % BLUESYNC_RX_RING_SIZE);
+}
+
+#endif /* ZEPHYR_BLUESYNC_SRC_BLUESYNC_RX_RING_H_ */
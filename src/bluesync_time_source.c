@@ -0,0 +1,113 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_time_source.c
+ * Description: Source of the local timestamps used by the synchronization
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#if defined(CONFIG_BLUESYNC_TIME_SOURCE_COUNTER)
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/counter.h>
+#endif
+
+#include "bluesync_time_source.h"
+
+LOG_MODULE_REGISTER(bluesync_time_source, CONFIG_BLUESYNC_LOG_LEVEL);
+
+#if defined(CONFIG_BLUESYNC_TIME_SOURCE_COUNTER)
+/*
+ * The counter is extended to 64 bits in software: every read adds the
+ * distance since the previous read, modulo the counter period. A periodic
+ * timer reads it at least twice per period so no wrap can be missed when
+ * no timestamp is taken for a while.
+ */
+static const struct device *const counter_dev = DEVICE_DT_GET(DT_CHOSEN(bluesync_counter));
+
+uint32_t bluesync_time_source_counter_hz;
+
+static struct {
+	uint64_t period;
+	uint32_t last;
+	int64_t extended;
+	struct k_spinlock lock;
+} counter_ext;
+
+static struct k_timer counter_wrap_timer;
+
+int64_t bluesync_time_source_counter_get(void) {
+	uint32_t value;
+	int64_t extended;
+
+	k_spinlock_key_t key = k_spin_lock(&counter_ext.lock);
+	{
+		(void)counter_get_value(counter_dev, &value);
+		counter_ext.extended += (int64_t)(((uint64_t)value + counter_ext.period - counter_ext.last) %
+						  counter_ext.period);
+		counter_ext.last = value;
+		extended = counter_ext.extended;
+	}
+	k_spin_unlock(&counter_ext.lock, key);
+
+	return extended;
+}
+
+static void counter_wrap_handler(struct k_timer *timer) {
+	ARG_UNUSED(timer);
+	(void)bluesync_time_source_counter_get();
+}
+
+int bluesync_time_source_init(void) {
+	int err;
+
+	if (!device_is_ready(counter_dev)) {
+		LOG_ERR("Counter device %s not ready", counter_dev->name);
+		return -ENODEV;
+	}
+
+	bluesync_time_source_counter_hz = counter_get_frequency(counter_dev);
+	counter_ext.period = (uint64_t)counter_get_top_value(counter_dev) + 1;
+
+	err = counter_start(counter_dev);
+	if (err && err != -EALREADY) {
+		LOG_ERR("Failed to start counter %s (err %d)", counter_dev->name, err);
+		return err;
+	}
+	(void)counter_get_value(counter_dev, &counter_ext.last);
+
+	uint64_t half_period_us = counter_ext.period * 1000000ULL / bluesync_time_source_counter_hz / 2;
+
+	k_timer_init(&counter_wrap_timer, counter_wrap_handler, NULL);
+	k_timer_start(&counter_wrap_timer, K_USEC(half_period_us), K_USEC(half_period_us));
+
+	LOG_INF("Time source: %s at %u Hz", counter_dev->name, bluesync_time_source_counter_hz);
+	return 0;
+}
+#else
+int bluesync_time_source_init(void) {
+#if defined(CONFIG_BLUESYNC_TIME_SOURCE_CYCLES)
+	LOG_INF("Time source: cycle counter at %u Hz", bluesync_time_source_hz());
+#else
+	LOG_INF("Time source: system ticks at %u Hz", bluesync_time_source_hz());
+#endif
+	return 0;
+}
+#endif
@@ -0,0 +1,88 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_time_source.h
+ * Description: Source of the local timestamps used by the synchronization
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+
+#ifndef ZEPHYR_BLUESYNC_SRC_BLUESYNC_TIME_SOURCE_H_
+#define ZEPHYR_BLUESYNC_SRC_BLUESYNC_TIME_SOURCE_H_
+
+#include <zephyr/kernel.h>
+#include <stdint.h>
+
+/*
+ * All the local timestamps (burst timestamps, logical time, conversions)
+ * are taken from the selected source and expressed in its ticks. The
+ * system ticks and the cycle counter are read inline, their rate is
+ * known at build time on most targets.
+ */
+
+/**
+ * @brief Initialise the time source. Must be called before any timestamp
+ * is taken.
+ * 
+ * @return int : 0 on success, negative errno otherwise
+ */
+int bluesync_time_source_init(void);
+
+#if defined(CONFIG_BLUESYNC_TIME_SOURCE_COUNTER)
+/**
+ * @brief Read the counter device, extended to 64 bits.
+ * 
+ * @return int64_t 
+ */
+int64_t bluesync_time_source_counter_get(void);
+
+extern uint32_t bluesync_time_source_counter_hz;
+#endif
+
+/**
+ * @brief Current value of the time source, in its own ticks.
+ * 
+ * @return int64_t 
+ */
+static inline int64_t bluesync_time_source_get(void)
+{
+#if defined(CONFIG_BLUESYNC_TIME_SOURCE_CYCLES)
+	return (int64_t)k_cycle_get_64();
+#elif defined(CONFIG_BLUESYNC_TIME_SOURCE_COUNTER)
+	return bluesync_time_source_counter_get();
+#else
+	return k_uptime_ticks();
+#endif
+}
+
+/**
+ * @brief Rate of the time source.
+ * 
+ * @return uint32_t : ticks per second
+ */
+static inline uint32_t bluesync_time_source_hz(void)
+{
+#if defined(CONFIG_BLUESYNC_TIME_SOURCE_CYCLES)
+	return (uint32_t)sys_clock_hw_cycles_per_sec();
+#elif defined(CONFIG_BLUESYNC_TIME_SOURCE_COUNTER)
+	return bluesync_time_source_counter_hz;
+#else
+	return CONFIG_SYS_CLOCK_TICKS_PER_SEC;
+#endif
+}
+
+#endif /* ZEPHYR_BLUESYNC_SRC_BLUESYNC_TIME_SOURCE_H_ */
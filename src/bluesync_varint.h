@@ -0,0 +1,79 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_varint.h
+ * Description: Variable-length (LEB128) encoding of unsigned integers
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+
+#ifndef ZEPHYR_BLUESYNC_SRC_BLUESYNC_VARINT_H_
+#define ZEPHYR_BLUESYNC_SRC_BLUESYNC_VARINT_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * @brief Maximum encoded size of a 64-bit value.
+ */
+#define BLUESYNC_VARINT_MAX_SIZE 10
+
+/**
+ * @brief Encode a value, 7 bits per byte, least significant group first.
+ * 
+ * @param value 
+ * @param dst : at least BLUESYNC_VARINT_MAX_SIZE bytes
+ * @return size_t : number of bytes written
+ */
+static inline size_t bluesync_varint_put(uint64_t value, uint8_t *dst)
+{
+	size_t n = 0;
+
+	while (value >= 0x80) {
+		dst[n++] = (uint8_t)value | 0x80;
+		value >>= 7;
+	}
+	dst[n++] = (uint8_t)value;
+
+	return n;
+}
+
+/**
+ * @brief Decode a value.
+ * 
+ * @param src 
+ * @param len : bytes available in @p src
+ * @param value : decoded value
+ * @return size_t : number of bytes read, 0 if @p src is truncated or
+ * the encoding is longer than BLUESYNC_VARINT_MAX_SIZE
+ */
+static inline size_t bluesync_varint_get(const uint8_t *src, size_t len, uint64_t *value)
+{
+	uint64_t result = 0;
+
+	for (size_t n = 0; n < len && n < BLUESYNC_VARINT_MAX_SIZE; n++) {
+		result |= (uint64_t)(src[n] & 0x7F) << (7 * n);
+		if (!(src[n] & 0x80)) {
+			*value = result;
+			return n + 1;
+		}
+	}
+
+	return 0;
+}
+
+#endif /* ZEPHYR_BLUESYNC_SRC_BLUESYNC_VARINT_H_ */
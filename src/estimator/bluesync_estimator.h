@@ -0,0 +1,75 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: bluesync_estimator.h
+ * Description: Interface of the slope/offset estimators (interface)
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#ifndef ZEPHYR_BLUESYNC_SRC_ESTIMATOR_BLUESYNC_ESTIMATOR_H_
+#define ZEPHYR_BLUESYNC_SRC_ESTIMATOR_BLUESYNC_ESTIMATOR_H_
+
+#include <stdint.h>
+
+#include "../bluesync.h"
+
+/**
+ * @brief Estimator computing the slope and offset of the local clock
+ * against the master clock from the burst history.
+ */
+struct bluesync_estimator {
+	/** Name of the estimator, used in logs */
+	const char *name;
+
+	/**
+	 * @brief Estimate the slope and offset of a window of bursts.
+	 *
+	 * @param bursts : array of committed bursts
+	 * @param count : number of bursts in @p bursts
+	 * @param slope : output slope
+	 * @param offset : output offset
+	 * @param min_nb_timestamp : minimal number of valid pairs required
+	 * @return bluesync_status_t
+	 */
+	bluesync_status_t (*estimate)(const struct bluesync_history_burst *bursts,
+				      size_t count,
+				      double *slope,
+				      double *offset,
+				      size_t min_nb_timestamp);
+
+	/**
+	 * @brief Optional hook called each time a burst is committed to the
+	 * history, for estimators carrying a state across rounds.
+	 *
+	 * @param burst : the burst just committed
+	 */
+	void (*add_burst)(const struct bluesync_history_burst *burst);
+
+	/**
+	 * @brief Optional hook called when the history is cleared (new role
+	 * or new epoch), for estimators carrying a state across rounds.
+	 */
+	void (*reset)(void);
+};
+
+/**
+ * @brief Estimator selected with CONFIG_BLUESYNC_ESTIMATOR.
+ * Each implementation file defines it when it is the selected one.
+ */
+extern const struct bluesync_estimator bluesync_estimator;
+
+#endif /* ZEPHYR_BLUESYNC_SRC_ESTIMATOR_BLUESYNC_ESTIMATOR_H_ */
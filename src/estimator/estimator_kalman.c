@@ -0,0 +1,263 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: estimator_kalman.c
+ * Description: Two-state (offset, skew) Kalman filter clock servo
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#include <zephyr/kernel.h>
+#include <math.h>
+#include <string.h>
+
+#include <bluesync/bluesync.h>
+#include "bluesync_estimator.h"
+#include "../bluesync_history.h"
+#include "../bluesync_time_source.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(bluesync_estimator_kalman, CONFIG_BLUESYNC_LOG_LEVEL);
+
+/*
+ * Unlike the regression estimators, the state is carried across rounds:
+ * each committed burst is folded in, sample by sample, and the history
+ * window is not read again. A window of one burst is enough.
+ *
+ * For each burst:
+ *  - predict: move the anchor to the first pair of the burst.
+ *    offset += skew * dt, and the skew random walk adds process noise,
+ *  - update: one scalar update per pair, with the measurement
+ *    z = (rcv - anchor_rcv) - (local - anchor_local) = offset + skew * d.
+ *    Pairs whose innovation exceeds the gate are dropped. When all the
+ *    pairs of a burst are, the master time stepped and the filter
+ *    restarts from that burst.
+ *
+ * CPU: O(slots) per round, independent of the window size.
+ * RAM: the filter state (80 bytes).
+ */
+
+#define MEAS_VAR ((CONFIG_BLUESYNC_KALMAN_MEAS_STDDEV_CTICKS / 100.0) * \
+		  (CONFIG_BLUESYNC_KALMAN_MEAS_STDDEV_CTICKS / 100.0))
+#define SKEW_RW_PER_TICK ((CONFIG_BLUESYNC_KALMAN_SKEW_RW_PPB * 1e-9) * \
+			  (CONFIG_BLUESYNC_KALMAN_SKEW_RW_PPB * 1e-9) / \
+			  bluesync_time_source_hz())
+#define INIT_SKEW_VAR ((CONFIG_BLUESYNC_KALMAN_INIT_SKEW_PPM * 1e-6) * \
+		       (CONFIG_BLUESYNC_KALMAN_INIT_SKEW_PPM * 1e-6))
+#define GATE (CONFIG_BLUESYNC_KALMAN_GATE / 10.0)
+
+/*
+ * The master clock is modelled around an anchor point as:
+ * rcv - anchor_rcv = (local - anchor_local) * (1 + skew) + offset
+ */
+struct bluesync_kalman_state {
+	bool initialized;
+	uint64_t anchor_local;	// local ticks of the anchor
+	uint64_t anchor_rcv;	// master ticks of the anchor
+	double offset;		// ticks, relative to the anchor
+	double skew;		// slope - 1
+	double cov[2][2];	// covariance of (offset, skew)
+	uint32_t nb_samples;	// samples folded since the initialisation
+};
+
+static struct bluesync_kalman_state kf;
+static K_MUTEX_DEFINE(kf_lock);
+
+static void kalman_predict(struct bluesync_kalman_state *s, uint64_t local, uint64_t rcv)
+{
+	double dt = (double)(int64_t)(local - s->anchor_local);
+
+	// Moving both anchors by the same amount keeps z unchanged
+	s->offset += s->skew * dt;
+	s->offset -= (double)(int64_t)((rcv - s->anchor_rcv) - (local - s->anchor_local));
+	s->anchor_local = local;
+	s->anchor_rcv = rcv;
+
+	// P = F P F' + Q, with F = [1 dt; 0 1] and a skew random walk
+	double p00 = s->cov[0][0], p01 = s->cov[0][1], p11 = s->cov[1][1];
+	double q = SKEW_RW_PER_TICK * fabs(dt);
+
+	s->cov[0][0] = p00 + 2.0 * dt * p01 + dt * dt * p11 + q * dt * dt / 3.0;
+	s->cov[0][1] = p01 + dt * p11 + q * fabs(dt) / 2.0;
+	s->cov[1][0] = s->cov[0][1];
+	s->cov[1][1] = p11 + q;
+}
+
+static bool kalman_update(struct bluesync_kalman_state *s, uint64_t local, uint64_t rcv)
+{
+	double d = (double)(int64_t)(local - s->anchor_local);
+	double z = (double)(int64_t)(rcv - s->anchor_rcv) - d;
+
+	// H = [1 d]
+	double ph0 = s->cov[0][0] + s->cov[0][1] * d;
+	double ph1 = s->cov[1][0] + s->cov[1][1] * d;
+	double innov_var = ph0 + ph1 * d + MEAS_VAR;
+	double innov = z - (s->offset + s->skew * d);
+
+	if (GATE > 0.0 && innov * innov > GATE * GATE * innov_var) {
+		return false;
+	}
+
+	double k0 = ph0 / innov_var;
+	double k1 = ph1 / innov_var;
+
+	s->offset += k0 * innov;
+	s->skew += k1 * innov;
+
+	// P = (I - K H) P
+	double p00 = s->cov[0][0] - k0 * ph0;
+	double p01 = s->cov[0][1] - k0 * ph1;
+	double p11 = s->cov[1][1] - k1 * ph1;
+
+	s->cov[0][0] = p00;
+	s->cov[0][1] = p01;
+	s->cov[1][0] = p01;
+	s->cov[1][1] = p11;
+
+	s->nb_samples++;
+	return true;
+}
+
+/* Called with kf_lock held, returns the number of pairs rejected */
+static size_t kalman_fold_burst(const struct bluesync_history_burst *burst)
+{
+	size_t rejected = 0;
+	size_t first = 0;
+
+	if (!kf.initialized) {
+		kf.anchor_local = burst->stats.origin_x;
+		kf.anchor_rcv = burst->stats.origin_y;
+		kf.offset = 0.0;
+		kf.skew = 0.0;
+		kf.cov[0][0] = MEAS_VAR;
+		kf.cov[0][1] = 0.0;
+		kf.cov[1][0] = 0.0;
+		kf.cov[1][1] = INIT_SKEW_VAR;
+		// The first pair is the anchor itself
+		kf.nb_samples = 1;
+		kf.initialized = true;
+		first = 1;
+	} else {
+		kalman_predict(&kf, burst->stats.origin_x, burst->stats.origin_y);
+	}
+
+	for (size_t i = first; i < burst->stats.n; i++) {
+		uint64_t x, y;
+
+		bluesync_history_get_pair(burst, i, &x, &y);
+		if (!kalman_update(&kf, x, y)) {
+			rejected++;
+		}
+	}
+
+	return rejected;
+}
+
+static void kalman_add_burst(const struct bluesync_history_burst *burst)
+{
+	size_t rejected;
+	bool stepped = false;
+
+	if (burst->stats.n == 0) {
+		return;
+	}
+
+	k_mutex_lock(&kf_lock, K_FOREVER);
+	{
+		bool initialized = kf.initialized;
+
+		rejected = kalman_fold_burst(burst);
+
+		// No pair passed the gate: the master time stepped (new epoch)
+		if (initialized && rejected == burst->stats.n) {
+			kf.initialized = false;
+			rejected = kalman_fold_burst(burst);
+			stepped = true;
+		}
+	}
+	k_mutex_unlock(&kf_lock);
+
+	if (stepped) {
+		LOG_WRN("Whole burst rejected by the innovation gate, filter restarted");
+	} else if (rejected) {
+		LOG_DBG("%zu pairs rejected by the innovation gate", rejected);
+	}
+}
+
+static void kalman_get_state(struct bluesync_kalman_state *state)
+{
+	k_mutex_lock(&kf_lock, K_FOREVER);
+	{
+		*state = kf;
+	}
+	k_mutex_unlock(&kf_lock);
+}
+
+static bluesync_status_t kalman_estimate(const struct bluesync_history_burst *bursts,
+					 size_t count,
+					 double *slope,
+					 double *offset,
+					 size_t min_nb_timestamp)
+{
+	struct bluesync_kalman_state s;
+
+	kalman_get_state(&s);
+
+	if (!s.initialized || s.nb_samples == 0) {
+		LOG_ERR("No valid data folded in the filter.");
+		return BLUESYNC_NO_VALID_DATA_STATUS;
+	} else if (s.nb_samples < min_nb_timestamp) {
+		LOG_ERR("Not enough valid samples in the filter (min = %zu, got = %u)",
+			min_nb_timestamp, s.nb_samples);
+		return BLUESYNC_NO_ENOUGH_DATA_STATUS;
+	}
+
+	*slope = 1.0 + s.skew;
+	*offset = (double)s.anchor_rcv + s.offset - *slope * (double)s.anchor_local;
+
+	return BLUESYNC_SUCCESS_STATUS;
+}
+
+/* New role or new epoch: the anchor belongs to the previous reference */
+static void kalman_reset(void)
+{
+	k_mutex_lock(&kf_lock, K_FOREVER);
+	{
+		kf.initialized = false;
+		kf.nb_samples = 0;
+	}
+	k_mutex_unlock(&kf_lock);
+}
+
+bool bluesync_get_servo_covariance(double cov[2][2])
+{
+	struct bluesync_kalman_state s;
+
+	kalman_get_state(&s);
+	if (!s.initialized) {
+		return false;
+	}
+
+	memcpy(cov, s.cov, sizeof(s.cov));
+	return true;
+}
+
+const struct bluesync_estimator bluesync_estimator = {
+	.name = "kalman",
+	.estimate = kalman_estimate,
+	.add_burst = kalman_add_burst,
+	.reset = kalman_reset,
+};
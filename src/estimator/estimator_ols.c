@@ -0,0 +1,33 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: estimator_ols.c
+ * Description: Ordinary least-squares estimator
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#include "bluesync_estimator.h"
+#include "../bluesync_regression.h"
+
+/*
+ * CPU: O(bursts), only the per-burst statistics are read.
+ * RAM: none besides the history.
+ */
+const struct bluesync_estimator bluesync_estimator = {
+	.name = "ols",
+	.estimate = bluesync_regression_from_stats,
+};
@@ -0,0 +1,217 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: estimator_theil_sen.c
+ * Description: Bounded-cost Theil-Sen (median of slopes) estimator
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#include <zephyr/kernel.h>
+#include <math.h>
+
+#include "bluesync_estimator.h"
+#include "../bluesync_history.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(bluesync_estimator_theil_sen, CONFIG_BLUESYNC_LOG_LEVEL);
+
+/*
+ * The complete Theil-Sen estimator uses the slopes of all the n(n-1)/2
+ * pairs. To bound the cost, the pair i is only matched with the pair
+ * i + n/2, i.e. half a window later, which gives the slopes with the
+ * largest leverage. At most MAX_PAIRS slopes are computed (evenly strided)
+ * and the slope is their median. The offset is the median of the
+ * intercepts of at most MAX_PAIRS pairs.
+ *
+ * CPU: O(MAX_PAIRS) pair decoding + two O(MAX_PAIRS) median selections.
+ * RAM: MAX_PAIRS doubles (static buffer, 512 bytes with the default).
+ */
+
+#define MAX_PAIRS CONFIG_BLUESYNC_ESTIMATOR_THEIL_SEN_MAX_PAIRS
+
+static double values[MAX_PAIRS];
+
+struct pair_cursor {
+	const struct bluesync_history_burst *bursts;
+	size_t count;
+	size_t burst;
+	size_t idx;
+};
+
+static void cursor_advance(struct pair_cursor *c, size_t step)
+{
+	c->idx += step;
+	while (c->burst < c->count && c->idx >= c->bursts[c->burst].stats.n) {
+		c->idx -= c->bursts[c->burst].stats.n;
+		c->burst++;
+	}
+}
+
+static void cursor_init(struct pair_cursor *c, const struct bluesync_history_burst *bursts,
+			size_t count, size_t start)
+{
+	c->bursts = bursts;
+	c->count = count;
+	c->burst = 0;
+	c->idx = 0;
+	cursor_advance(c, start);
+}
+
+static void cursor_get(const struct pair_cursor *c, uint64_t *x, uint64_t *y)
+{
+	bluesync_history_get_pair(&c->bursts[c->burst], c->idx, x, y);
+}
+
+/* Quickselect: place the k-th smallest value at index k */
+static double select_kth(double *v, size_t n, size_t k)
+{
+	size_t lo = 0, hi = n - 1;
+
+	while (lo < hi) {
+		double pivot = v[(lo + hi) / 2];
+		size_t i = lo, j = hi;
+
+		while (i <= j) {
+			while (v[i] < pivot) {
+				i++;
+			}
+			while (v[j] > pivot) {
+				j--;
+			}
+			if (i <= j) {
+				double tmp = v[i];
+
+				v[i] = v[j];
+				v[j] = tmp;
+				i++;
+				if (j == 0) {
+					break;
+				}
+				j--;
+			}
+		}
+
+		if (k <= j) {
+			hi = j;
+		} else if (k >= i) {
+			lo = i;
+		} else {
+			break;
+		}
+	}
+
+	return v[k];
+}
+
+static double median(double *v, size_t n)
+{
+	double upper = select_kth(v, n, n / 2);
+
+	if (n % 2) {
+		return upper;
+	}
+
+	// After the selection, v[0 .. n/2-1] holds the lower half
+	double lower = v[0];
+
+	for (size_t i = 1; i < n / 2; i++) {
+		lower = MAX(lower, v[i]);
+	}
+
+	return (lower + upper) / 2.0;
+}
+
+static bluesync_status_t theil_sen_estimate(const struct bluesync_history_burst *bursts,
+					    size_t count,
+					    double *slope,
+					    double *offset,
+					    size_t min_nb_timestamp)
+{
+	size_t n = 0;
+
+	for (size_t b = 0; b < count; b++) {
+		n += bursts[b].stats.n;
+	}
+
+	if (n == 0) {
+		LOG_ERR("No valid data in history for regression.");
+		return BLUESYNC_NO_VALID_DATA_STATUS;
+	} else if (n < min_nb_timestamp || n < 2) {
+		LOG_ERR("Not enough valid samples in history (min = %zu, got = %zu)", min_nb_timestamp, n);
+		return BLUESYNC_NO_ENOUGH_DATA_STATUS;
+	}
+
+	// Slopes between pair i and pair i + n/2
+	size_t half = n / 2;
+	size_t nb_slopes = MIN((size_t)MAX_PAIRS, n - half);
+	size_t step = (n - half) / nb_slopes;
+	size_t cnt = 0;
+	struct pair_cursor a, b;
+
+	cursor_init(&a, bursts, count, 0);
+	cursor_init(&b, bursts, count, half);
+
+	for (size_t k = 0; k < nb_slopes; k++) {
+		uint64_t xa, ya, xb, yb;
+
+		cursor_get(&a, &xa, &ya);
+		cursor_get(&b, &xb, &yb);
+
+		int64_t dx = (int64_t)(xb - xa);
+
+		if (dx != 0) {
+			values[cnt++] = (double)(int64_t)(yb - ya) / (double)dx;
+		}
+
+		cursor_advance(&a, step);
+		cursor_advance(&b, step);
+	}
+
+	if (cnt == 0) {
+		LOG_ERR("No pair with distinct local timestamps");
+		return BLUESYNC_DENOMINATOR_TOO_SMALL;
+	}
+
+	*slope = median(values, cnt);
+
+	// Intercepts, centred on the first pair to keep the precision
+	uint64_t ref_x, ref_y;
+	size_t nb_intercepts = MIN((size_t)MAX_PAIRS, n);
+
+	step = n / nb_intercepts;
+	cursor_init(&a, bursts, count, 0);
+	cursor_get(&a, &ref_x, &ref_y);
+
+	for (size_t k = 0; k < nb_intercepts; k++) {
+		uint64_t x, y;
+
+		cursor_get(&a, &x, &y);
+		values[k] = (double)(int64_t)(y - ref_y) - *slope * (double)(int64_t)(x - ref_x);
+		cursor_advance(&a, step);
+	}
+
+	double intercept = median(values, nb_intercepts);
+
+	*offset = (double)ref_y + intercept - *slope * (double)ref_x;
+
+	return BLUESYNC_SUCCESS_STATUS;
+}
+
+const struct bluesync_estimator bluesync_estimator = {
+	.name = "theil-sen",
+	.estimate = theil_sen_estimate,
+};
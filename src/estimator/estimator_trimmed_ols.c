@@ -0,0 +1,194 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: estimator_trimmed_ols.c
+ * Description: Iterative least-squares estimator with residual trimming
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#include <zephyr/kernel.h>
+#include <math.h>
+
+#include "bluesync_estimator.h"
+#include "../bluesync_history.h"
+#include "../bluesync_regression.h"
+
+#include <zephyr/logging/log.h>
+LOG_MODULE_REGISTER(bluesync_estimator_trimmed, CONFIG_BLUESYNC_LOG_LEVEL);
+
+/*
+ * Starts from the ordinary least-squares fit, then at each iteration:
+ *  - computes the RMS of the residuals,
+ *  - drops the pairs whose residual exceeds THRESHOLD x RMS
+ *    (and at least MIN_TICKS, the timestamps are quantised),
+ *  - refits the remaining pairs.
+ * Every iteration re-tests all the pairs, so an outlier is rejected again
+ * at each pass. It stops as soon as an iteration rejects as many pairs as
+ * the previous one (none for the first): the inlier set has settled and
+ * another refit would give the same line.
+ *
+ * CPU: O(bursts) + 2 x ITERATIONS passes over the stored pairs.
+ * RAM: none besides the history, the residuals are recomputed on the fly.
+ */
+
+#define TRIM_THRESHOLD (CONFIG_BLUESYNC_ESTIMATOR_TRIMMED_THRESHOLD / 10.0)
+
+/* Line y = slope * x + intercept, centred on the origin of a reference burst */
+struct centred_line {
+	uint64_t ref_x;
+	uint64_t ref_y;
+	double slope;
+	double intercept;
+};
+
+static double pair_residual(const struct centred_line *line, uint64_t x, uint64_t y)
+{
+	double dx = (double)(int64_t)(x - line->ref_x);
+	double dy = (double)(int64_t)(y - line->ref_y);
+
+	return dy - (line->slope * dx + line->intercept);
+}
+
+static double residual_rms(const struct centred_line *line,
+			   const struct bluesync_history_burst *bursts, size_t count)
+{
+	double sum_r2 = 0.0;
+	size_t n = 0;
+
+	for (size_t b = 0; b < count; b++) {
+		for (size_t i = 0; i < bursts[b].stats.n; i++) {
+			uint64_t x, y;
+
+			bluesync_history_get_pair(&bursts[b], i, &x, &y);
+
+			double r = pair_residual(line, x, y);
+
+			sum_r2 += r * r;
+			n++;
+		}
+	}
+
+	return (n > 0) ? sqrt(sum_r2 / n) : 0.0;
+}
+
+static bluesync_status_t refit_inliers(struct centred_line *line,
+				       const struct bluesync_history_burst *bursts, size_t count,
+				       double threshold, size_t min_nb_timestamp, size_t *rejected)
+{
+	double sum_x = 0.0, sum_y = 0.0, sum_xx = 0.0, sum_xy = 0.0;
+	size_t n = 0;
+
+	*rejected = 0;
+
+	for (size_t b = 0; b < count; b++) {
+		for (size_t i = 0; i < bursts[b].stats.n; i++) {
+			uint64_t x, y;
+
+			bluesync_history_get_pair(&bursts[b], i, &x, &y);
+
+			if (fabs(pair_residual(line, x, y)) > threshold) {
+				(*rejected)++;
+				continue;
+			}
+
+			double dx = (double)(int64_t)(x - line->ref_x);
+			double dy = (double)(int64_t)(y - line->ref_y);
+
+			sum_x += dx;
+			sum_y += dy;
+			sum_xx += dx * dx;
+			sum_xy += dx * dy;
+			n++;
+		}
+	}
+
+	if (*rejected == 0) {
+		return BLUESYNC_SUCCESS_STATUS;
+	}
+
+	if (n < min_nb_timestamp) {
+		LOG_ERR("Not enough inliers after trimming (min = %zu, got = %zu)", min_nb_timestamp, n);
+		return BLUESYNC_NO_ENOUGH_DATA_STATUS;
+	}
+
+	double sum_var = sum_xx - sum_x * sum_x / n;
+	double sum_cov = sum_xy - sum_x * sum_y / n;
+
+	if (fabs(sum_var) < 1e-12) {
+		LOG_ERR("Variance too small → numerical instability (%e)", sum_var);
+		return BLUESYNC_DENOMINATOR_TOO_SMALL;
+	}
+
+	line->slope = sum_cov / sum_var;
+	line->intercept = (sum_y - line->slope * sum_x) / n;
+
+	return BLUESYNC_SUCCESS_STATUS;
+}
+
+static bluesync_status_t trimmed_ols_estimate(const struct bluesync_history_burst *bursts,
+					      size_t count,
+					      double *slope,
+					      double *offset,
+					      size_t min_nb_timestamp)
+{
+	bluesync_status_t status;
+
+	status = bluesync_regression_from_stats(bursts, count, slope, offset, min_nb_timestamp);
+	if (status != BLUESYNC_SUCCESS_STATUS) {
+		return status;
+	}
+
+	struct centred_line line = {0};
+
+	for (size_t b = 0; b < count; b++) {
+		if (bursts[b].stats.n > 0) {
+			line.ref_x = bursts[b].stats.origin_x;
+			line.ref_y = bursts[b].stats.origin_y;
+			break;
+		}
+	}
+	line.slope = *slope;
+	line.intercept = *offset + *slope * (double)line.ref_x - (double)line.ref_y;
+
+	size_t prev_rejected = 0;
+
+	for (int iter = 0; iter < CONFIG_BLUESYNC_ESTIMATOR_TRIMMED_ITERATIONS; iter++) {
+		double threshold = MAX(TRIM_THRESHOLD * residual_rms(&line, bursts, count),
+				       (double)CONFIG_BLUESYNC_ESTIMATOR_TRIMMED_MIN_TICKS);
+		size_t rejected;
+
+		status = refit_inliers(&line, bursts, count, threshold, min_nb_timestamp, &rejected);
+		if (status != BLUESYNC_SUCCESS_STATUS) {
+			return status;
+		}
+		if (rejected == prev_rejected) {
+			break;
+		}
+		prev_rejected = rejected;
+		LOG_DBG("Iteration %d: %zu pairs rejected (threshold %.1f ticks)", iter, rejected, threshold);
+	}
+
+	*slope = line.slope;
+	*offset = (double)line.ref_y + line.intercept - line.slope * (double)line.ref_x;
+
+	return BLUESYNC_SUCCESS_STATUS;
+}
+
+const struct bluesync_estimator bluesync_estimator = {
+	.name = "trimmed-ols",
+	.estimate = trimmed_ols_estimate,
+};
@@ -21,68 +21,290 @@
  */
 
 #include <zephyr/kernel.h>
+#include <zephyr/sys/atomic.h>
+#include <zephyr/sys/barrier.h>
 #include <math.h>
 #include <stdint.h>
 #include <stdio.h>
 
-#define BLUESYNC_TICK_RATE_HZ 32768
+#include "local_time.h"
+#include "bluesync_fixed_point.h"
+#include "bluesync_time_source.h"
 
-#if defined(CONFIG_BLUESYNC_TEST_BABBLESIM_SUPPORT)
-// BabbleSim or POSIX simulation environment
+#define BLUESYNC_TICK_RATE_HZ bluesync_time_source_hz()
+
+#if defined(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)
+// Integer only conversions (no soft-float on single precision FPUs)
+#define us_to_ticks(us)        bs_fp_us_to_ticks((uint64_t)(us), BLUESYNC_TICK_RATE_HZ)
+#define ticks_to_us(ticks)     bs_fp_ticks_to_us((int64_t)(ticks), BLUESYNC_TICK_RATE_HZ)
+#else
 #define us_to_ticks(us)        ((uint64_t)(((double)(us)) * BLUESYNC_TICK_RATE_HZ / 1e6 + 0.5))
 #define ticks_to_us(ticks)     ((uint64_t)(((double)(ticks)) * 1e6 / BLUESYNC_TICK_RATE_HZ))
-#else
-// Real hardware (use Zephyr-provided tick macros)
-#define us_to_ticks(us)        ((uint64_t)(((double)(us)) * 32768.0 / 1e6 + 0.5))
-#define ticks_to_us(ticks)     ((uint64_t)(((double)(ticks)) * 1e6 / 32768.0))
 #endif
 
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+#define SLEW_HORIZON_TICKS        ((double)CONFIG_BLUESYNC_SLEW_HORIZON_MS * BLUESYNC_TICK_RATE_HZ / 1000.0)
+#define SLEW_STEP_THRESHOLD_TICKS ((double)CONFIG_BLUESYNC_SLEW_STEP_THRESHOLD_MS * BLUESYNC_TICK_RATE_HZ / 1000.0)
+#define SLEW_MAX_RATE             (CONFIG_BLUESYNC_SLEW_MAX_RATE_PPM * 1e-6)
+#endif
+
+#if defined(CONFIG_BLUESYNC_TIME_MAP)
+#define TIME_MAP_SIZE CONFIG_BLUESYNC_TIME_MAP_SIZE
 
-#define LOCAL_FREQ_HZ BLUESYNC_TICK_RATE_HZ
+/* Correction that was in force from start_ticks until the next segment */
+struct local_time_segment {
+	int64_t start_ticks;
+	struct local_time_snapshot snap;
+};
+#endif
 
+/*
+ * The correction parameters are published through a sequence counter.
+ * Writers bump the counter to an odd value, update the snapshot and bump it
+ * back to an even value. Readers copy the snapshot without taking any lock
+ * and retry if the counter changed or was odd while copying. The writer holds
+ * a spinlock so that it cannot be interrupted by a reader running in an ISR
+ * on the same CPU (which would otherwise spin forever).
+ */
 struct local_time {
-	uint64_t uptime_ref_ticks;
-	uint64_t epoch_ref_ticks;
-	uint64_t epoch_ref_us;
-	bool epoch_ref_valid;
-	double curent_offset_ticks; // Offset correction factor
-	double curent_slope_ticks;  // Drift correction factor
-	struct k_mutex mutex;
+	atomic_t seq;
+	struct local_time_snapshot snap;
+#if defined(CONFIG_BLUESYNC_TIME_MAP)
+	// Uptime from which snap is in force
+	int64_t start_ticks;
+	// Ring of the previous corrections, in chronological order
+	struct local_time_segment map[TIME_MAP_SIZE];
+	uint8_t map_head;
+	uint8_t map_count;
+#endif
+	struct k_spinlock lock;
 };
 
 static struct local_time local = {
-	.uptime_ref_ticks = 0,
-	.epoch_ref_ticks = 0,
-	.epoch_ref_valid = false,
-	.curent_offset_ticks = 0.0,
-	.curent_slope_ticks = 1.0,
-	.mutex = Z_MUTEX_INITIALIZER(local.mutex),
+	.seq = ATOMIC_INIT(0),
+	.snap = {
+		.uptime_ref_ticks = 0,
+		.epoch_ref_ticks = 0,
+		.epoch_ref_us = 0,
+		.epoch_ref_valid = false,
+		.offset_ticks = 0.0,
+		.slope_ticks = 1.0,
+#if defined(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)
+		.skew_q48 = 0,
+		.offset_int_ticks = 0,
+		.offset_frac_q32 = 0,
+#endif
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+		.slew_end_ticks = 0,
+		.slew_rate = 0.0,
+#if defined(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)
+		.slew_rate_q48 = 0,
+#endif
+#endif
+	},
+#if defined(CONFIG_BLUESYNC_TIME_MAP)
+	.start_ticks = 0,
+	.map_head = 0,
+	.map_count = 0,
+#endif
 };
 
-uint64_t get_logical_time_ticks_(int64_t uptime_ticks) {
-    uint64_t delta_ticks;
-    double slope, offset;
+static k_spinlock_key_t local_time_write_begin(void) {
+	k_spinlock_key_t key = k_spin_lock(&local.lock);
+
+	atomic_inc(&local.seq);
+	barrier_dmem_fence_full();
+	return key;
+}
+
+static void local_time_write_end(k_spinlock_key_t key) {
+	barrier_dmem_fence_full();
+	atomic_inc(&local.seq);
+	k_spin_unlock(&local.lock, key);
+}
+
+void local_time_snapshot_get(struct local_time_snapshot *snap) {
+	atomic_val_t seq;
+
+	do {
+		seq = atomic_get(&local.seq);
+		if (seq & 1) {
+			continue; // writer in progress
+		}
+		*snap = local.snap;
+		barrier_dmem_fence_full();
+	} while ((seq & 1) || seq != atomic_get(&local.seq));
+}
+
+#if defined(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)
+static uint64_t snapshot_logical_ticks(const struct local_time_snapshot *snap, int64_t uptime_ticks) {
+	int64_t delta_ticks = (int64_t)((uint64_t)uptime_ticks - snap->uptime_ref_ticks);
+
+	// delta * (1 + skew) + offset, with the fractional part kept in Q32
+	int64_t frac_q32;
+	int64_t skew_ticks = bs_fp_mul_q48(delta_ticks, snap->skew_q48, &frac_q32);
+
+	frac_q32 += snap->offset_frac_q32;
+
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+	// Remaining part of the slewed error
+	if (uptime_ticks < snap->slew_end_ticks) {
+		frac_q32 -= bs_fp_mul_shift(snap->slew_end_ticks - uptime_ticks, snap->slew_rate_q48,
+					    BS_FP_SKEW_FRAC_BITS - BS_FP_OFFSET_FRAC_BITS);
+	}
+#endif
+
+	int64_t corrected = delta_ticks + skew_ticks + snap->offset_int_ticks + bs_fp_round_q32(frac_q32);
+
+	if (snap->epoch_ref_valid) {
+		corrected += snap->epoch_ref_ticks;
+	}
 
-    k_mutex_lock(&local.mutex, K_FOREVER);
-    {
-        if (uptime_ticks == -1) {
-            delta_ticks = k_uptime_ticks() - local.uptime_ref_ticks;
-        } else {
-            delta_ticks = (uint64_t)uptime_ticks - local.uptime_ref_ticks;
-        }
+	return (uint64_t)corrected;
+}
+#else
+static uint64_t snapshot_logical_ticks(const struct local_time_snapshot *snap, int64_t uptime_ticks) {
+	uint64_t delta_ticks = (uint64_t)uptime_ticks - snap->uptime_ref_ticks;
+	double corrected = (double)delta_ticks * snap->slope_ticks + snap->offset_ticks;
+
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+	// Remaining part of the slewed error
+	if (uptime_ticks < snap->slew_end_ticks) {
+		corrected -= snap->slew_rate * (double)(snap->slew_end_ticks - uptime_ticks);
+	}
+#endif
+
+	if (snap->epoch_ref_valid) {
+		corrected += snap->epoch_ref_ticks;
+	}
+
+	return (uint64_t)round(corrected);
+}
+#endif
+
+#if defined(CONFIG_BLUESYNC_TIME_MAP)
+/* Must be called in a write section, before the snapshot is modified */
+static void local_time_map_push(int64_t now) {
+	local.map[local.map_head].start_ticks = local.start_ticks;
+	local.map[local.map_head].snap = local.snap;
+	local.map_head = (local.map_head + 1) % TIME_MAP_SIZE;
+	if (local.map_count < TIME_MAP_SIZE) {
+		local.map_count++;
+	}
+	local.start_ticks = now;
+}
+
+/*
+ * Binary search of the last segment starting at or before uptime_ticks.
+ * Returns false if the segment was already evicted, the oldest one is
+ * then copied.
+ */
+static bool local_time_map_lookup(int64_t uptime_ticks, struct local_time_snapshot *snap) {
+	if (uptime_ticks >= local.start_ticks || local.map_count == 0) {
+		*snap = local.snap;
+		return true;
+	}
 
-        slope = local.curent_slope_ticks;
-        offset = local.curent_offset_ticks;
-    }
-    k_mutex_unlock(&local.mutex);
+	size_t oldest = (local.map_head + TIME_MAP_SIZE - local.map_count) % TIME_MAP_SIZE;
+	size_t lo = 0, hi = local.map_count;
 
-    double corrected = (double)delta_ticks * slope + offset;
+	// Invariant: segments [0, lo) start at or before uptime_ticks, [hi, count) after
+	while (lo < hi) {
+		size_t mid = (lo + hi) / 2;
 
-    if (local.epoch_ref_valid) {
-        corrected += local.epoch_ref_ticks;
-    }
+		if (local.map[(oldest + mid) % TIME_MAP_SIZE].start_ticks <= uptime_ticks) {
+			lo = mid + 1;
+		} else {
+			hi = mid;
+		}
+	}
+
+	if (lo == 0) {
+		*snap = local.map[oldest].snap;
+		return false;
+	}
+
+	*snap = local.map[(oldest + lo - 1) % TIME_MAP_SIZE].snap;
+	return true;
+}
+
+static bool local_time_snapshot_get_at(int64_t uptime_ticks, struct local_time_snapshot *snap) {
+	atomic_val_t seq;
+	bool covered = false;
+
+	do {
+		seq = atomic_get(&local.seq);
+		if (seq & 1) {
+			continue; // writer in progress
+		}
+		covered = local_time_map_lookup(uptime_ticks, snap);
+		barrier_dmem_fence_full();
+	} while ((seq & 1) || seq != atomic_get(&local.seq));
+
+	return covered;
+}
+
+bool convert_past_uptime_ticks_to_est_master_ticks(int64_t uptime_ticks, uint64_t *logical_ticks) {
+	struct local_time_snapshot snap;
+	bool covered = local_time_snapshot_get_at(uptime_ticks, &snap);
+
+	*logical_ticks = snapshot_logical_ticks(&snap, uptime_ticks);
+	return covered;
+}
+#endif
+
+static uint64_t snapshot_unix_time_us(const struct local_time_snapshot *snap, uint64_t logical_tick) {
+	int64_t delta_ticks = (int64_t)logical_tick - (int64_t)snap->epoch_ref_ticks;
+	int64_t delta_us = (int64_t)ticks_to_us(delta_ticks);
 
-    return (uint64_t)round(corrected);
+	return snap->epoch_ref_us + delta_us;
+}
+
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+/* Correction at uptime_ticks, without the epoch reference and the rounding */
+static double snapshot_correction(const struct local_time_snapshot *snap, int64_t uptime_ticks) {
+	double corrected = (double)(uptime_ticks - (int64_t)snap->uptime_ref_ticks) * snap->slope_ticks +
+			   snap->offset_ticks;
+
+	if (uptime_ticks < snap->slew_end_ticks) {
+		corrected -= snap->slew_rate * (double)(snap->slew_end_ticks - uptime_ticks);
+	}
+
+	return corrected;
+}
+
+/*
+ * Absorb the error between the previous and the new correction linearly
+ * until slew_end_ticks instead of stepping. The horizon is stretched so the
+ * rate never exceeds SLEW_MAX_RATE: the logical clock keeps a positive slope
+ * and stays monotonic. Errors beyond the step threshold (e.g. the first
+ * synchronisation) are applied at once.
+ */
+static void snapshot_slew_start(struct local_time_snapshot *snap, int64_t now, double error) {
+	if (fabs(error) > SLEW_STEP_THRESHOLD_TICKS) {
+		snap->slew_end_ticks = now;
+		snap->slew_rate = 0.0;
+	} else {
+		double horizon = MAX(SLEW_HORIZON_TICKS, fabs(error) / SLEW_MAX_RATE);
+
+		snap->slew_end_ticks = now + (int64_t)ceil(horizon);
+		snap->slew_rate = error / (double)(snap->slew_end_ticks - now);
+	}
+#if defined(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)
+	snap->slew_rate_q48 = llround(snap->slew_rate * (double)(INT64_C(1) << BS_FP_SKEW_FRAC_BITS));
+#endif
+}
+#endif
+
+uint64_t get_logical_time_ticks_(int64_t uptime_ticks) {
+	struct local_time_snapshot snap;
+
+	if (uptime_ticks == -1) {
+		uptime_ticks = bluesync_time_source_get();
+	}
+
+	local_time_snapshot_get(&snap);
+	return snapshot_logical_ticks(&snap, uptime_ticks);
 }
 
 uint64_t convert_uptime_ticks_to_est_master_ticks(int64_t uptime_ticks) {
@@ -99,65 +321,206 @@ uint64_t get_logical_time_ticks() {
 }
 
 void apply_timer_sync(double new_slope, double new_offset) {
+#if defined(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)
+	// Converted once per round, the read path only uses integers
+	int64_t skew_q48 = llround((new_slope - 1.0) * (double)(INT64_C(1) << BS_FP_SKEW_FRAC_BITS));
+	double offset_int = floor(new_offset);
+	int64_t offset_frac_q32 = llround((new_offset - offset_int) *
+					  (double)(INT64_C(1) << BS_FP_OFFSET_FRAC_BITS));
+#endif
+
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION) || defined(CONFIG_BLUESYNC_TIME_MAP)
+	int64_t now = bluesync_time_source_get();
+#endif
 
-	k_mutex_lock(&local.mutex, K_FOREVER);
+	k_spinlock_key_t key = local_time_write_begin();
 	{
-		local.curent_slope_ticks = new_slope;
-		local.curent_offset_ticks = new_offset;
+#if defined(CONFIG_BLUESYNC_TIME_MAP)
+		local_time_map_push(now);
+#endif
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+		double error = snapshot_correction(&local.snap, now);
+#endif
+		local.snap.slope_ticks = new_slope;
+		local.snap.offset_ticks = new_offset;
+#if defined(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)
+		local.snap.skew_q48 = skew_q48;
+		local.snap.offset_int_ticks = (int64_t)offset_int;
+		local.snap.offset_frac_q32 = offset_frac_q32;
+#endif
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+		local.snap.slew_end_ticks = now;
+		error = snapshot_correction(&local.snap, now) - error;
+		snapshot_slew_start(&local.snap, now, error);
+#endif
 	}
-    k_mutex_unlock(&local.mutex);
+	local_time_write_end(key);
 }
 
 
 void set_new_epoch_unix_ref(uint64_t epoch_ref_us){
 	uint64_t epoch_ref_ticks = us_to_ticks(epoch_ref_us);
+	int64_t uptime_ticks = bluesync_time_source_get();
 
-	k_mutex_lock(&local.mutex, K_FOREVER);
+	k_spinlock_key_t key = local_time_write_begin();
 	{
-		local.uptime_ref_ticks = k_uptime_ticks();
-		local.epoch_ref_ticks = epoch_ref_ticks;
-		local.epoch_ref_us = epoch_ref_us;
-		local.epoch_ref_valid = true;
+#if defined(CONFIG_BLUESYNC_TIME_MAP)
+		local_time_map_push(uptime_ticks);
+#endif
+		local.snap.uptime_ref_ticks = uptime_ticks;
+		local.snap.epoch_ref_ticks = epoch_ref_ticks;
+		local.snap.epoch_ref_us = epoch_ref_us;
+		local.snap.epoch_ref_valid = true;
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+		// A slew still running belongs to the previous reference
+		local.snap.slew_end_ticks = uptime_ticks;
+		local.snap.slew_rate = 0.0;
+#if defined(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)
+		local.snap.slew_rate_q48 = 0;
+#endif
+#endif
 	}
-	k_mutex_unlock(&local.mutex);
+	local_time_write_end(key);
 }
 
 
 uint64_t ticks_to_us_unix_time(uint64_t logical_tick) {
-	k_mutex_lock(&local.mutex, K_FOREVER);
+	struct local_time_snapshot snap;
 
+	local_time_snapshot_get(&snap);
+	return snapshot_unix_time_us(&snap, logical_tick);
+}
 
-	int64_t delta_ticks = (int64_t)logical_tick - (int64_t)local.epoch_ref_ticks;
-	int64_t delta_us = (int64_t)ticks_to_us(delta_ticks);
-	uint64_t result = local.epoch_ref_us + delta_us;
+uint64_t get_unix_time_us_at_uptime(int64_t uptime_ticks) {
+	struct local_time_snapshot snap;
 
-	k_mutex_unlock(&local.mutex);
-	return result;
+	// Single snapshot: the tick conversion and the epoch conversion
+	// always use the same set of parameters.
+	local_time_snapshot_get(&snap);
+	return snapshot_unix_time_us(&snap, snapshot_logical_ticks(&snap, uptime_ticks));
+}
+
+#if defined(CONFIG_BLUESYNC_TIME_MAP)
+bool get_unix_time_us_at_past_uptime(int64_t uptime_ticks, uint64_t *unix_time_us) {
+	struct local_time_snapshot snap;
+	bool covered = local_time_snapshot_get_at(uptime_ticks, &snap);
+
+	*unix_time_us = snapshot_unix_time_us(&snap, snapshot_logical_ticks(&snap, uptime_ticks));
+	return covered;
+}
+#endif
+
+/* Integer form of a snapshot, used by the batch conversion */
+struct local_time_fixed {
+	int64_t uptime_ref_ticks;
+	int64_t skew_q48;
+	int64_t offset_int_ticks; // Includes -epoch_ref_ticks when no epoch reference is set
+	int64_t offset_frac_q32;
+	uint64_t epoch_ref_us;
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+	int64_t slew_end_ticks;
+	int64_t slew_rate_q48;
+#endif
+};
+
+static void snapshot_to_fixed(const struct local_time_snapshot *snap, struct local_time_fixed *fx) {
+#if defined(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)
+	fx->skew_q48 = snap->skew_q48;
+	fx->offset_int_ticks = snap->offset_int_ticks;
+	fx->offset_frac_q32 = snap->offset_frac_q32;
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+	fx->slew_rate_q48 = snap->slew_rate_q48;
+#endif
+#else
+	// Once per batch, amortised over all the elements
+	double offset_int = floor(snap->offset_ticks);
+
+	fx->skew_q48 = llround((snap->slope_ticks - 1.0) * (double)(INT64_C(1) << BS_FP_SKEW_FRAC_BITS));
+	fx->offset_int_ticks = (int64_t)offset_int;
+	fx->offset_frac_q32 = llround((snap->offset_ticks - offset_int) *
+				      (double)(INT64_C(1) << BS_FP_OFFSET_FRAC_BITS));
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+	fx->slew_rate_q48 = llround(snap->slew_rate * (double)(INT64_C(1) << BS_FP_SKEW_FRAC_BITS));
+#endif
+#endif
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+	fx->slew_end_ticks = snap->slew_end_ticks;
+#endif
+	fx->uptime_ref_ticks = (int64_t)snap->uptime_ref_ticks;
+	fx->epoch_ref_us = snap->epoch_ref_us;
+	if (!snap->epoch_ref_valid) {
+		fx->offset_int_ticks -= (int64_t)snap->epoch_ref_ticks;
+	}
+}
+
+void convert_uptime_ticks_to_unix_time_us_batch(const int64_t *uptime_ticks, uint64_t *unix_time_us,
+						size_t count) {
+	struct local_time_snapshot snap;
+	struct local_time_fixed fx;
+	uint32_t rate_hz = BLUESYNC_TICK_RATE_HZ;
+
+	local_time_snapshot_get(&snap);
+	snapshot_to_fixed(&snap, &fx);
+
+	for (size_t i = 0; i < count; i++) {
+		int64_t uptime = uptime_ticks[i];
+		int64_t delta_ticks = uptime - fx.uptime_ref_ticks;
+		int64_t frac_q32;
+		int64_t skew_ticks = bs_fp_mul_q48(delta_ticks, fx.skew_q48, &frac_q32);
+
+		frac_q32 += fx.offset_frac_q32;
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+		if (uptime < fx.slew_end_ticks) {
+			frac_q32 -= bs_fp_mul_shift(fx.slew_end_ticks - uptime, fx.slew_rate_q48,
+						    BS_FP_SKEW_FRAC_BITS - BS_FP_OFFSET_FRAC_BITS);
+		}
+#endif
+
+		// Logical ticks relative to the epoch reference
+		int64_t ticks = delta_ticks + skew_ticks + fx.offset_int_ticks + bs_fp_round_q32(frac_q32);
+
+		// May overwrite uptime_ticks[i] when converting in place
+		unix_time_us[i] = fx.epoch_ref_us + bs_fp_ticks_to_us(ticks, rate_hz);
+	}
+}
+
+int64_t get_local_timestamp_ticks(void) {
+	return bluesync_time_source_get();
 }
 
 uint64_t get_current_unix_time_us(void) {
-	return ticks_to_us_unix_time(get_logical_time_ticks());
+	return get_unix_time_us_at_uptime(bluesync_time_source_get());
 }
 
 
 int64_t get_uptime_ticks_with_epoch(){
-	int64_t curent_uptime_ticks =  k_uptime_ticks();
-	uint64_t ticks = 0;
+	struct local_time_snapshot snap;
+	int64_t curent_uptime_ticks =  bluesync_time_source_get();
 
-	k_mutex_lock(&local.mutex, K_FOREVER);
-	{
-		ticks = local.epoch_ref_ticks + (curent_uptime_ticks - local.uptime_ref_ticks);
-	}
-	k_mutex_unlock(&local.mutex);
-	return ticks;
+	local_time_snapshot_get(&snap);
+	return snap.epoch_ref_ticks + (curent_uptime_ticks - snap.uptime_ref_ticks);
+}
+
+void get_current_slope_offset_ticks(double *slope, double *offset){
+	struct local_time_snapshot snap;
+
+	local_time_snapshot_get(&snap);
+	*slope = snap.slope_ticks;
+	*offset = snap.offset_ticks;
 }
 
 double get_current_slope_ticks(){
-	return local.curent_slope_ticks;
+	struct local_time_snapshot snap;
+
+	local_time_snapshot_get(&snap);
+	return snap.slope_ticks;
 }
 
 double get_current_offset_ticks(){
-	return local.curent_offset_ticks;
+	struct local_time_snapshot snap;
+
+	local_time_snapshot_get(&snap);
+	return snap.offset_ticks;
 }
 
 uint64_t uncompress_time(uint32_t compress_32bit_timestamp){
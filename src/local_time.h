@@ -24,7 +24,45 @@
  
 #ifndef ZEPHYR_BLUESYNC_SRC_LOCAL_TIME_H_
 #define ZEPHYR_BLUESYNC_SRC_LOCAL_TIME_H_
+#include <stddef.h>
 #include <stdint.h>
+#include <stdbool.h>
+
+/**
+ * @brief Snapshot of the clock correction parameters.
+ * 
+ * All the fields belong to the same correction: a snapshot taken with
+ * local_time_snapshot_get() never mixes a new slope with an old offset
+ * or epoch reference.
+ */
+struct local_time_snapshot {
+	uint64_t uptime_ref_ticks;
+	uint64_t epoch_ref_ticks;
+	uint64_t epoch_ref_us;
+	bool epoch_ref_valid;
+	double offset_ticks; // Offset correction factor
+	double slope_ticks;  // Drift correction factor
+#if defined(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)
+	int64_t skew_q48;         // (slope - 1) in Q16.48
+	int64_t offset_int_ticks; // Integer part of the offset
+	int64_t offset_frac_q32;  // Fractional part of the offset in Q32, [0, 2^32)
+#endif
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+	int64_t slew_end_ticks;   // Uptime at which the slew is over
+	double slew_rate;         // Error absorbed per tick until slew_end_ticks
+#if defined(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)
+	int64_t slew_rate_q48;    // slew_rate in Q16.48
+#endif
+#endif
+};
+
+/**
+ * @brief Copy a consistent snapshot of the correction parameters.
+ * This method is lock-free and can be called from an ISR.
+ * 
+ * @param snap : destination of the snapshot
+ */
+void local_time_snapshot_get(struct local_time_snapshot *snap);
 
 /**
  * @brief Get the logical time us value. 
@@ -54,7 +92,52 @@ uint64_t get_logical_time_ticks(void);
  * @param uptime_ticks : value that should be concerted 
  * @return uint64_t 
  */
-uint64_t convert_uptime_ticks_to_est_master_ticks(uint64_t uptime_ticks);
+uint64_t convert_uptime_ticks_to_est_master_ticks(int64_t uptime_ticks);
+
+/**
+ * @brief Convert a past uptime ticks value with the correction that was
+ * in force at that time. The previous corrections are kept in a bounded
+ * ring (CONFIG_BLUESYNC_TIME_MAP_SIZE) searched by binary search.
+ * This method is lock-free and can be called from an ISR.
+ * 
+ * @param uptime_ticks : value returned by bluesync_time_source_get() when the 
+ * timestamp was taken
+ * @param logical_ticks : converted value
+ * @return true if the correction was still in the ring, false if the
+ * oldest available correction was used instead
+ */
+bool convert_past_uptime_ticks_to_est_master_ticks(int64_t uptime_ticks, uint64_t *logical_ticks);
+
+/**
+ * @brief Convert a logical ticks value into a unix epoch timestamp in us.
+ * 
+ * @param logical_tick 
+ * @return uint64_t 
+ */
+uint64_t ticks_to_us_unix_time(uint64_t logical_tick);
+
+/**
+ * @brief Convert an array of uptime ticks values into unix epoch timestamps in us.
+ * The correction is read once for the whole array, and the conversion
+ * only uses integer arithmetic. 
+ * 
+ * @param uptime_ticks : values returned by bluesync_time_source_get()
+ * @param unix_time_us : converted values, may be the same buffer as 
+ * @p uptime_ticks for an in-place conversion
+ * @param count : number of values
+ */
+void convert_uptime_ticks_to_unix_time_us_batch(const int64_t *uptime_ticks, uint64_t *unix_time_us,
+						size_t count);
+
+/**
+ * @brief Get the current slope and offset ticks values. 
+ * Both values come from the same correction, even if 
+ * apply_timer_sync() runs concurrently.
+ * 
+ * @param slope 
+ * @param offset 
+ */
+void get_current_slope_offset_ticks(double *slope, double *offset);
 
 /**
  * @brief Get the current slope ticks value
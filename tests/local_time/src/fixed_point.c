@@ -0,0 +1,100 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: fixed_point.c
+ * Description: Fixed-point correction against the double correction
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <math.h>
+
+#include "local_time.h"
+
+#define TICKS_PER_DAY (24LL * 3600 * 32768)
+
+/* Skews of real oscillators and beyond, in ppm */
+static const double skews_ppm[] = {0.0, 0.5, -0.5, 3.7, -12.5, 37.25, -99.9, 200.0, -500.0};
+
+/* Offsets: none, close to a half tick, and a client one (unix epoch ticks) */
+static const double offsets_ticks[] = {0.0, 0.4999, -0.5001, 123.5, 1750000000.0 * 32768 + 0.4375};
+
+/*
+ * Uptimes from zero to several days, and around the 31 and 32 bits wraps
+ * (the 32-bit cycle and counter extensions) and 2^40 ticks (~1 year).
+ */
+static const int64_t uptimes_ticks[] = {
+	0, 1, 32767, 32768, 3600LL * 32768, TICKS_PER_DAY, 3 * TICKS_PER_DAY + 12345,
+	7 * TICKS_PER_DAY - 1, BIT64(31) - 1, BIT64(31), BIT64(32) - 1, BIT64(32),
+	BIT64(32) + 1, BIT64(40) - 1, BIT64(40),
+};
+
+/* The correction computed in double, as without CONFIG_BLUESYNC_FIXED_POINT_CORRECTION */
+static double double_logical_ticks(const struct local_time_snapshot *snap, int64_t uptime_ticks){
+	double corrected = (double)(uptime_ticks - (int64_t)snap->uptime_ref_ticks) * snap->slope_ticks +
+			   snap->offset_ticks;
+
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+	if (uptime_ticks < snap->slew_end_ticks) {
+		corrected -= snap->slew_rate * (double)(snap->slew_end_ticks - uptime_ticks);
+	}
+#endif
+
+	if (snap->epoch_ref_valid) {
+		corrected += (double)snap->epoch_ref_ticks;
+	}
+
+	return corrected;
+}
+
+static void check_uptimes(void){
+	struct local_time_snapshot snap;
+
+	local_time_snapshot_get(&snap);
+
+	for (size_t i = 0; i < ARRAY_SIZE(uptimes_ticks); i++) {
+		// Also just before and after the uptime reference of the correction
+		int64_t uptimes[] = {uptimes_ticks[i], (int64_t)snap.uptime_ref_ticks + uptimes_ticks[i],
+				     (int64_t)snap.uptime_ref_ticks - uptimes_ticks[i]};
+
+		for (size_t j = 0; j < ARRAY_SIZE(uptimes); j++) {
+			double expected = double_logical_ticks(&snap, uptimes[j]);
+			double actual = (double)(int64_t)convert_uptime_ticks_to_est_master_ticks(uptimes[j]);
+
+			zassert_true(fabs(actual - expected) <= 1.0,
+				     "uptime %lld, slope %.9f, offset %.4f: %.3f instead of %.3f",
+				     (long long)uptimes[j], snap.slope_ticks, snap.offset_ticks,
+				     actual, expected);
+		}
+	}
+}
+
+ZTEST(local_time_fixed_point, test_within_one_tick_of_double){
+	if (!IS_ENABLED(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)) {
+		ztest_test_skip();
+	}
+
+	for (size_t s = 0; s < ARRAY_SIZE(skews_ppm); s++) {
+		for (size_t o = 0; o < ARRAY_SIZE(offsets_ticks); o++) {
+			apply_timer_sync(1.0 + skews_ppm[s] * 1e-6, offsets_ticks[o]);
+			check_uptimes();
+		}
+	}
+}
+
+ZTEST_SUITE(local_time_fixed_point, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,179 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: main.c
+ * Description: Batch conversion of timestamps, error bound and benchmark
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <string.h>
+
+#include <bluesync/bluesync.h>
+#include "local_time.h"
+#include "bluesync_time_source.h"
+
+#define BUF_SIZE_SMALL 256
+#define BUF_SIZE_LARGE 1024
+
+// Spacing of the timestamps: even ones within the slew horizon, odd ones up to ~30 days ahead
+#define NEAR_STEP_TICKS 97
+#define FAR_STEP_TICKS  (30LL * 24 * 3600 * 32768 / BUF_SIZE_LARGE)
+
+// Client correction: the logical time is the master time, ~2025 in unix epoch ticks
+#define CLIENT_SLOPE  (1.0 + 37.25e-6)
+#define CLIENT_OFFSET (1750000000.0 * 32768 + 0.4375)
+
+/*
+ * Largest difference between the batch and the per-element conversions.
+ * With the fixed-point correction both run the same integer arithmetic.
+ * Otherwise the per-element path rounds the logical time in double, which
+ * may land on the other tick than the Q32 rounding of the batch when the
+ * fraction is close to one half, and truncates the microseconds in double,
+ * which may be one below the exact integer floor of the batch.
+ */
+static uint32_t batch_max_error_us(void){
+#if defined(CONFIG_BLUESYNC_FIXED_POINT_CORRECTION)
+	return 0;
+#else
+	return DIV_ROUND_UP(USEC_PER_SEC, bluesync_time_source_hz()) + 1;
+#endif
+}
+
+static int64_t uptime_ticks[BUF_SIZE_LARGE];
+static uint64_t batch_us[BUF_SIZE_LARGE];
+static uint64_t single_us[BUF_SIZE_LARGE];
+
+static void fill_uptime_ticks(size_t count){
+	int64_t now = bluesync_time_source_get();
+
+	for (size_t i = 0; i < count; i++) {
+		uptime_ticks[i] = now + (int64_t)i * ((i & 1) ? FAR_STEP_TICKS : NEAR_STEP_TICKS);
+	}
+}
+
+/* Per-element conversion of the buffer, in cycles */
+static uint32_t convert_single(size_t count){
+	uint32_t start = k_cycle_get_32();
+
+	for (size_t i = 0; i < count; i++) {
+		single_us[i] = get_unix_time_us_at_uptime(uptime_ticks[i]);
+	}
+
+	return k_cycle_get_32() - start;
+}
+
+/* Batch conversion of the buffer, in cycles */
+static uint32_t convert_batch(size_t count){
+	uint32_t start = k_cycle_get_32();
+
+	convert_uptime_ticks_to_unix_time_us_batch(uptime_ticks, batch_us, count);
+
+	return k_cycle_get_32() - start;
+}
+
+static uint64_t max_error_us(size_t count){
+	uint64_t max_error = 0;
+
+	for (size_t i = 0; i < count; i++) {
+		uint64_t error = batch_us[i] > single_us[i] ? batch_us[i] - single_us[i] :
+							      single_us[i] - batch_us[i];
+
+		max_error = MAX(max_error, error);
+	}
+
+	return max_error;
+}
+
+static void check_batch(size_t count){
+	fill_uptime_ticks(count);
+	convert_single(count);
+	convert_batch(count);
+
+	uint64_t max_error = max_error_us(count);
+
+	TC_PRINT("%zu values: max error %llu us (bound %u us)\n", count,
+		 (unsigned long long)max_error, batch_max_error_us());
+	zassert_true(max_error <= batch_max_error_us(),
+		     "batch differs by %llu us from the per-element conversion",
+		     (unsigned long long)max_error);
+}
+
+static void benchmark(size_t count){
+	fill_uptime_ticks(count);
+
+	// Warm up the caches, then keep the best of a few runs
+	uint32_t best_single = UINT32_MAX;
+	uint32_t best_batch = UINT32_MAX;
+
+	for (int run = 0; run < 4; run++) {
+		best_single = MIN(best_single, convert_single(count));
+		best_batch = MIN(best_batch, convert_batch(count));
+	}
+
+	TC_PRINT("%zu values: per-element %u cycles (%u/value), batch %u cycles (%u/value)\n",
+		 count, best_single, best_single / (uint32_t)count, best_batch,
+		 best_batch / (uint32_t)count);
+}
+
+static void client_correction_apply(void){
+	apply_timer_sync(CLIENT_SLOPE, CLIENT_OFFSET);
+#if defined(CONFIG_BLUESYNC_SLEW_CORRECTION)
+	// A small error with the previous correction is slewed, not stepped
+	apply_timer_sync(CLIENT_SLOPE - 1.5e-6, CLIENT_OFFSET + 3.3);
+#endif
+}
+
+ZTEST(local_time_batch, test_client_error_bound){
+	client_correction_apply();
+
+	check_batch(BUF_SIZE_SMALL);
+	check_batch(BUF_SIZE_LARGE);
+}
+
+ZTEST(local_time_batch, test_client_in_place){
+	client_correction_apply();
+	fill_uptime_ticks(BUF_SIZE_SMALL);
+	convert_single(BUF_SIZE_SMALL);
+
+	// The output may alias the input
+	convert_uptime_ticks_to_unix_time_us_batch(uptime_ticks, (uint64_t *)uptime_ticks,
+						   BUF_SIZE_SMALL);
+	memcpy(batch_us, uptime_ticks, BUF_SIZE_SMALL * sizeof(batch_us[0]));
+
+	zassert_true(max_error_us(BUF_SIZE_SMALL) <= batch_max_error_us());
+}
+
+ZTEST(local_time_batch, test_benchmark){
+	client_correction_apply();
+
+	benchmark(BUF_SIZE_SMALL);
+	benchmark(BUF_SIZE_LARGE);
+}
+
+/* The epoch reference cannot be cleared: runs after the client tests (by name) */
+ZTEST(local_time_batch, test_epoch_error_bound){
+	// Epoch reference set, as on the Authority, with a corrected drift
+	set_new_epoch_unix_ref(1750000000ULL * USEC_PER_SEC + 123457);
+	apply_timer_sync(1.0 - 12.5e-6, 0.4375);
+
+	check_batch(BUF_SIZE_SMALL);
+	check_batch(BUF_SIZE_LARGE);
+}
+
+ZTEST_SUITE(local_time_batch, NULL, NULL, NULL, NULL, NULL);
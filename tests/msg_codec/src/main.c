@@ -0,0 +1,237 @@
+/*
+ * Copyright 2025 Tobias Moullet
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ *
+ * File: main.c
+ * Description: Varints and version 3 packets, encode, validate and decode
+ *
+ * Project: BlueSync - BLE Time Sync for Zephyr
+ * Repository: https://github.com/Tobi15/zephyr-bluesync-ble
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/ztest.h>
+#include <string.h>
+
+#include "bluesync.h"
+#include "bluesync_msg.h"
+#include "bluesync_varint.h"
+#include "bluesync_bitfields.h"
+
+#define ROUND_ID 42
+#define HOP 2
+#define UNCERTAINTY_US 137
+
+// TX timestamps of a burst: ~1 year of uptime at 32768 Hz, slots 200 ms apart
+#define TX_START_TICKS (365ULL * 24 * 3600 * 32768)
+#define TX_INTERVAL_TICKS 6554
+
+static uint64_t tx_ticks[SLOT_NUMBER];
+static uint8_t payload[BLUESYNC_MSG_MAX_SIZE];
+
+static void tx_ticks_fill(uint64_t start){
+	for (size_t i = 0; i < SLOT_NUMBER; i++) {
+		// A few ticks of jitter, as on air
+		tx_ticks[i] = start + i * TX_INTERVAL_TICKS + (i * 7) % 5;
+	}
+}
+
+/* Master timestamp of a slot as carried by a version 3 packet */
+static uint64_t delta_ticks(int slot){
+	return slot == 0 ? tx_ticks[0] : tx_ticks[slot] - tx_ticks[0];
+}
+
+static void encode_decode(uint8_t slot, struct bluesync_msg_client *msg){
+	size_t len = bluesync_msg_encode(payload, ROUND_ID, slot, tx_ticks, HOP, UNCERTAINTY_US);
+
+	zassert_true(len <= BLUESYNC_MSG_MAX_SIZE, "slot %u: %zu bytes", slot, len);
+	zassert_not_equal(len, sizeof(struct bluesync_msg), "slot %u: original length", slot);
+	zassert_true(bluesync_msg_valid(payload, len), "slot %u: rejected", slot);
+
+	memset(msg, 0, sizeof(*msg));
+	bluesync_msg_decode(msg, payload, len, 1234);
+}
+
+/* Master timestamps of a packet stored as on the client, see bluesync.c */
+static void receive(bluesync_timestamps_t *rcv, const struct bluesync_msg_client *msg){
+	int slot = msg->rcv.index_timeslot;
+
+	if (slot >= 1 && slot <= SLOT_NUMBER) {
+		set_bit(rcv->bitfield, slot - 1);
+		rcv->timer_ticks[slot - 1] = msg->rcv.master_timer_ticks;
+	}
+#if BLUESYNC_MSG_FOLLOW_UP_COUNT > 1
+	for (int i = 0; i < msg->nb_follow_up && slot - 2 - i >= 0; i++) {
+		if (slot - 2 - i < SLOT_NUMBER) {
+			set_bit(rcv->bitfield, slot - 2 - i);
+			rcv->timer_ticks[slot - 2 - i] = msg->follow_up_ticks[i];
+		}
+	}
+#endif
+}
+
+ZTEST(msg_codec, test_varint_round_trip){
+	static const struct {
+		uint64_t value;
+		size_t size;
+	} cases[] = {
+		{0, 1}, {1, 1}, {127, 1}, {128, 2}, {16383, 2}, {16384, 3},
+		{TX_INTERVAL_TICKS * SLOT_NUMBER, 3}, {UINT32_MAX, 5}, {BIT64(35), 6},
+		{TX_START_TICKS, 6}, {UINT64_MAX, BLUESYNC_VARINT_MAX_SIZE},
+	};
+	uint8_t buf[BLUESYNC_VARINT_MAX_SIZE];
+
+	for (size_t i = 0; i < ARRAY_SIZE(cases); i++) {
+		uint64_t value = 0;
+		size_t n = bluesync_varint_put(cases[i].value, buf);
+
+		zassert_equal(n, cases[i].size, "case %zu: %zu bytes", i, n);
+		zassert_equal(bluesync_varint_get(buf, n, &value), n, "case %zu", i);
+		zassert_equal(value, cases[i].value, "case %zu", i);
+
+		// Truncated: the continuation bit of the last byte read is set
+		zassert_equal(bluesync_varint_get(buf, n - 1, &value), 0, "case %zu", i);
+	}
+}
+
+ZTEST(msg_codec, test_varint_too_long){
+	uint8_t buf[BLUESYNC_VARINT_MAX_SIZE + 1];
+	uint64_t value;
+
+	// Continuation set on all the bytes a 64-bit value may use
+	memset(buf, 0x80, sizeof(buf));
+	buf[BLUESYNC_VARINT_MAX_SIZE] = 0x00;
+
+	zassert_equal(bluesync_varint_get(buf, sizeof(buf), &value), 0);
+}
+
+ZTEST(msg_codec, test_delta_round_trip){
+	struct bluesync_msg_client msg;
+
+	tx_ticks_fill(TX_START_TICKS);
+
+	for (int slot = 0; slot <= SLOT_NUMBER; slot++) {
+		int nb_ticks = MIN(slot, BLUESYNC_MSG_FOLLOW_UP_COUNT);
+
+		encode_decode(slot, &msg);
+
+		zassert_true(msg.delta_coded);
+		zassert_equal(msg.rcv.round_id, ROUND_ID);
+		zassert_equal(msg.rcv.index_timeslot, slot);
+		zassert_equal(msg.client_timer_ticks, 1234);
+		zassert_equal(msg.rcv.master_timer_ticks, slot == 0 ? 0 : delta_ticks(slot - 1),
+			      "slot %d", slot);
+#if BLUESYNC_MSG_FOLLOW_UP_COUNT > 1
+		zassert_equal(msg.nb_follow_up, MAX(nb_ticks, 1) - 1, "slot %d", slot);
+		for (int i = 0; i < msg.nb_follow_up; i++) {
+			zassert_equal(msg.follow_up_ticks[i], delta_ticks(slot - 2 - i),
+				      "slot %d, follow-up %d", slot, i);
+		}
+#else
+		ARG_UNUSED(nb_ticks);
+#endif
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+		zassert_equal(msg.hop, HOP);
+		zassert_equal(msg.uncertainty_us, UNCERTAINTY_US);
+#endif
+	}
+}
+
+ZTEST(msg_codec, test_padded_length){
+	struct bluesync_msg_client msg;
+	// Varint bytes of a slot 1 packet that would give the original length
+	size_t varint_size = sizeof(struct bluesync_msg) - sizeof(struct bluesync_msg_delta) -
+			     BLUESYNC_MSG_QUALITY_LEN;
+
+	tx_ticks_fill(BIT64(7 * (varint_size - 1)));
+
+	size_t len = bluesync_msg_encode(payload, ROUND_ID, 1, tx_ticks, HOP, UNCERTAINTY_US);
+
+	zassert_equal(len, sizeof(struct bluesync_msg) + 1, "%zu bytes", len);
+	zassert_true(bluesync_msg_valid(payload, len));
+
+	bluesync_msg_decode(&msg, payload, len, 0);
+	zassert_true(msg.delta_coded);
+	zassert_equal(msg.rcv.index_timeslot, 1);
+	zassert_equal(msg.rcv.master_timer_ticks, tx_ticks[0]);
+
+	// The unpadded packet is read as the original format
+	len--;
+	payload[sizeof(struct bluesync_msg_delta) + varint_size - 1] &= 0x7F;
+#if defined(CONFIG_BLUESYNC_SOURCE_SELECTION)
+	memmove(&payload[sizeof(struct bluesync_msg_delta) + varint_size],
+		&payload[sizeof(struct bluesync_msg_delta) + varint_size + 1],
+		BLUESYNC_MSG_QUALITY_LEN);
+#endif
+	zassert_equal(len, sizeof(struct bluesync_msg));
+	bluesync_msg_decode(&msg, payload, len, 0);
+	zassert_false(msg.delta_coded);
+}
+
+ZTEST(msg_codec, test_invalid_length){
+	tx_ticks_fill(TX_START_TICKS);
+
+	for (int slot = 1; slot <= SLOT_NUMBER; slot++) {
+		size_t len = bluesync_msg_encode(payload, ROUND_ID, slot, tx_ticks, HOP, UNCERTAINTY_US);
+
+		// One byte short or one byte too many, unless it is the original length
+		if (len - 1 != sizeof(struct bluesync_msg)) {
+			zassert_false(bluesync_msg_valid(payload, len - 1), "slot %d", slot);
+		}
+		if (len + 1 != sizeof(struct bluesync_msg) && len < BLUESYNC_MSG_MAX_SIZE) {
+			zassert_false(bluesync_msg_valid(payload, len + 1), "slot %d", slot);
+		}
+	}
+
+	zassert_false(bluesync_msg_valid(payload, sizeof(struct bluesync_msg_delta) - 1));
+}
+
+ZTEST(msg_codec, test_resolve_deltas){
+	struct bluesync_msg_client msg;
+	bluesync_timestamps_t rcv = {0};
+
+	tx_ticks_fill(TX_START_TICKS);
+
+	for (int slot = 1; slot <= SLOT_NUMBER; slot++) {
+		encode_decode(slot, &msg);
+		receive(&rcv, &msg);
+	}
+
+	zassert_true(bluesync_msg_resolve_deltas(&rcv));
+	for (int slot = 0; slot < SLOT_NUMBER; slot++) {
+		zassert_true(is_bit_set(rcv.bitfield, slot));
+		zassert_equal(rcv.timer_ticks[slot], tx_ticks[slot], "slot %d", slot);
+	}
+}
+
+ZTEST(msg_codec, test_lost_slot_0){
+	struct bluesync_msg_client msg;
+	bluesync_timestamps_t rcv = {0};
+
+	tx_ticks_fill(TX_START_TICKS);
+
+	// The packets of the slots 1 to BLUESYNC_MSG_FOLLOW_UP_COUNT carry slot 0
+	for (int slot = BLUESYNC_MSG_FOLLOW_UP_COUNT + 1; slot <= SLOT_NUMBER; slot++) {
+		encode_decode(slot, &msg);
+		receive(&rcv, &msg);
+	}
+	zassert_false(is_bit_set(rcv.bitfield, 0));
+	zassert_true(count_set_bits(rcv.bitfield, NB_BYTES_BITFIELD) > 0);
+
+	// The deltas cannot be resolved: no pair of the round is left
+	zassert_false(bluesync_msg_resolve_deltas(&rcv));
+	zassert_equal(count_set_bits(rcv.bitfield, NB_BYTES_BITFIELD), 0);
+}
+
+ZTEST_SUITE(msg_codec, NULL, NULL, NULL, NULL, NULL);